@@ -19,149 +19,3560 @@ Die Kommentare zur Funktionsbeschreibung befinden sich über der jeweiligen Funk
 #include <linux/uaccess.h>
 #include <linux/proc_fs.h>
 #include <linux/delay.h>
+#include <linux/interrupt.h>
+#include <linux/wait.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/kfifo.h>
+#include <linux/poll.h>
+#include <linux/completion.h>
+#include <linux/log2.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
+#include <linux/kthread.h>
+#include <linux/cpumask.h>
+#include <linux/string.h>
+#include <linux/spi/spi.h>
+#include <linux/bitrev.h>
+#include <linux/slab.h>
+#include <linux/mempool.h>
+#include <linux/pm_runtime.h>
+#include <linux/pinctrl/consumer.h>
+#include <linux/configfs.h>
+#include <linux/fs.h>
+#include <linux/iio/consumer.h>
+#include <linux/iio/iio.h>
+#include <linux/sort.h>
+#include <linux/thermal.h>
+#include <asm/unaligned.h>
+
+#include "monitoring_system.h"
 
 #define MONITORING_SYS_ADDR 0x10
 #define MAX_BUFFER_SIZE 773 // 1 Byte Adresse + (256 * 1 Byte Wert ID) + (256 * 2 Byte Wert) + 4 Byte CRC = 773 Bytes
+#define MAX_WINDOW_SIZE 8
+#define SEQ_MASK 0x7F
+#define SEQ_FLAG_RESYNC 0x80 // Empfänger übernimmt diese Sequenznummer ohne Prüfung als neuen Stand
+#define MANCHESTER_PREAMBLE 0x55 // Wechselnde Bits vor jedem Frame, an denen der Empfänger den Takt zurückgewinnt
+#define RX_FIFO_SIZE 4096     // Platz für mehrere empfangene Frames inklusive 2 Byte Längenangabe pro Frame
+#define TXN_HIST_BUCKETS 20   // Latenz Histogramm mit Zweierpotenz-Klassen von <2 us bis >=512 ms
+#define DELAY_CAL_SAMPLES 16  // Anzahl Messungen für die Kalibrierung der Sleep/Spin Schwelle
+#define DELAY_CAL_US 10       // Kurzes Delay, dessen Verspätung beim Schlafen gemessen wird
+#define TOGGLE_CAL_SAMPLES 64 // Anzahl GPIO Zugriffe pro Leitung für die Messung der Toggle-Kosten
+#define RATE_MAX_LEVEL 6      // Stufe n teilt das konfigurierte Timing durch 2^n
+#define RATE_EVAL_FRAMES 16   // Anzahl Frames, über die die Fehlerrate bewertet wird
+#define RATE_FAIL_RUN 3       // So viele Fehlschläge in Folge führen sofort zur nächst langsameren Stufe
+#define IIO_MAX_CHANNELS 16   // Maximale Anzahl io-channels, die auf Wert IDs abgebildet werden
+
+/* Meta Information */
+MODULE_AUTHOR("Leya Wehner & Julian Frank");
+MODULE_DESCRIPTION("Monitoring System I2C Driver");
+MODULE_LICENSE("GPL");
+
+/* Bit Timing in us, Datenbit anlegen -> msc high -> msc low */
+static unsigned int t_setup_us = 100;
+module_param(t_setup_us, uint, 0644);
+MODULE_PARM_DESC(t_setup_us, "Zeit zwischen Anlegen des Datenbits und steigender Flanke von msc in us (Default: 100)");
+
+static unsigned int t_high_us = 200;
+module_param(t_high_us, uint, 0644);
+MODULE_PARM_DESC(t_high_us, "High-Phase von msc in us (Default: 200)");
+
+static unsigned int t_low_us = 100;
+module_param(t_low_us, uint, 0644);
+MODULE_PARM_DESC(t_low_us, "Low-Phase von msc nach jedem Bit in us (Default: 100)");
+
+/* Automatische Anpassung der Bitrate (benötigt ack-gpio) */
+static bool adaptive_rate = false;
+module_param(adaptive_rate, bool, 0644);
+MODULE_PARM_DESC(adaptive_rate, "Schnellere Bit Timings automatisch ausprobieren, benoetigt ack-gpio (Default: false)");
+
+static unsigned int rate_up_after = 64;
+module_param(rate_up_after, uint, 0644);
+MODULE_PARM_DESC(rate_up_after, "Anzahl fehlerfreier Frames in Folge, bevor die naechste Stufe probiert wird (Default: 64)");
+
+static unsigned int rate_error_pct = 10;
+module_param(rate_error_pct, uint, 0644);
+MODULE_PARM_DESC(rate_error_pct, "Fehlerrate in Prozent, ab der auf die langsamere Stufe zurueckgeschaltet wird (Default: 10)");
+
+/* Flusssteuerung (optional, nur wenn ready-gpio im Device Tree gesetzt ist) */
+static bool ready_per_byte = false;
+module_param(ready_per_byte, bool, 0644);
+MODULE_PARM_DESC(ready_per_byte, "ready-gpio vor jedem Byte statt nur vor jedem Frame pruefen (Default: false)");
+
+static unsigned int ready_timeout_ms = 1000;
+module_param(ready_timeout_ms, uint, 0644);
+MODULE_PARM_DESC(ready_timeout_ms, "Maximale Wartezeit auf einen beschaeftigten Empfaenger in ms (Default: 1000)");
+
+/* Empfang (optional, nur wenn rxc-gpio und rxd-gpio im Device Tree gesetzt sind) */
+static unsigned int rx_idle_us = 1000;
+module_param(rx_idle_us, uint, 0644);
+MODULE_PARM_DESC(rx_idle_us, "Pause auf rxc in us, nach der ein empfangener Frame als abgeschlossen gilt (Default: 1000)");
+
+static unsigned int txn_timeout_max_ms = 5000;
+module_param(txn_timeout_max_ms, uint, 0644);
+MODULE_PARM_DESC(txn_timeout_max_ms, "Obergrenze fuer timeout_ms von MONSYS_IOC_TRANSACT in ms (Default: 5000)");
+
+/* Delays zwischen den Flanken */
+static int delay_threshold_us = -1;
+module_param(delay_threshold_us, int, 0444);
+MODULE_PARM_DESC(delay_threshold_us, "Kuerzere Delays werden aktiv gewartet statt geschlafen, -1 = beim Probe kalibrieren (Default: -1)");
+
+static bool toggle_compensation = true;
+module_param(toggle_compensation, bool, 0644);
+MODULE_PARM_DESC(toggle_compensation, "Beim Probe gemessene GPIO Zugriffszeiten von den Delays abziehen (Default: true)");
+
+static bool coalesce_delays = false;
+module_param(coalesce_delays, bool, 0644);
+MODULE_PARM_DESC(coalesce_delays, "Low-Phase und Setup-Zeit zu einem Delay zusammenlegen, msd wechselt direkt nach der fallenden Flanke (Default: false)");
+
+/* Spin Engine: Übertragung auf einer dedizierten (isolierten) CPU mit aktivem Warten statt usleep_range */
+static int spin_cpu = -1;
+module_param(spin_cpu, int, 0644);
+MODULE_PARM_DESC(spin_cpu, "CPU fuer die Spin Engine, -1 = usleep_range Engine (Default: -1)");
+
+// 0 würde die Präemption für den ganzen Frame sperren und wird abgelehnt
+static int monitoring_sys_set_spin_burst(const char *val, const struct kernel_param *kp)
+{
+    unsigned int n;
+    int ret;
+
+    ret = kstrtouint(val, 0, &n);
+    if (ret)
+        return ret;
+    if (!n)
+        return -EINVAL;
+    return param_set_uint(val, kp);
+}
+
+static const struct kernel_param_ops spin_burst_ops = {
+    .set = monitoring_sys_set_spin_burst,
+    .get = param_get_uint,
+};
+
+static unsigned int spin_burst_bytes = 4;
+module_param_cb(spin_burst_bytes, &spin_burst_ops, &spin_burst_bytes, 0644);
+MODULE_PARM_DESC(spin_burst_bytes, "Bytes pro Burst ohne Praeemption in der Spin Engine, mindestens 1 (Default: 4)");
+
+/* Target Modus: die Gegenstelle treibt msc, der Treiber legt nur die Datenbits an */
+static unsigned int target_timeout_ms = 5000;
+module_param(target_timeout_ms, uint, 0644);
+MODULE_PARM_DESC(target_timeout_ms, "Maximale Zeit im Target Modus, bis die Gegenstelle einen Frame abgeholt hat, in ms (Default: 5000)");
+
+/* Quittierung (optional, nur wenn ack-gpio im Device Tree gesetzt ist) */
+static unsigned int ack_retries = 3;
+module_param(ack_retries, uint, 0644);
+MODULE_PARM_DESC(ack_retries, "Anzahl der Wiederholungen eines nicht quittierten Frames (Default: 3)");
+
+static unsigned int ack_timeout_us = 2000;
+module_param(ack_timeout_us, uint, 0644);
+MODULE_PARM_DESC(ack_timeout_us, "Wartezeit auf ACK/NACK nach dem CRC in us (Default: 2000)");
+
+static unsigned int nack_pulse_us = 50;
+module_param(nack_pulse_us, uint, 0644);
+MODULE_PARM_DESC(nack_pulse_us, "Pulse auf ack-gpio ab dieser Laenge in us gelten als NACK (Default: 50)");
+
+static unsigned int window_size = 1;
+module_param(window_size, uint, 0444);
+MODULE_PARM_DESC(window_size, "Anzahl gleichzeitig unquittierter Frames, >1 aktiviert Sequenznummern (Default: 1, Max: 8)");
+
+/* Frame-Puffer */
+static unsigned int queue_depth = 16;
+module_param(queue_depth, uint, 0444);
+MODULE_PARM_DESC(queue_depth, "Maximale Anzahl wartender Frames und beim Probe reservierter Frame-Puffer (Default: 16)");
+
+/* Runtime PM */
+static unsigned int autosuspend_ms = 1000;
+module_param(autosuspend_ms, uint, 0444);
+MODULE_PARM_DESC(autosuspend_ms, "Zeit ohne Uebertragung bis zum Runtime Suspend in ms, zur Laufzeit ueber power/autosuspend_delay_ms (Default: 1000)");
+
+/* IIO Consumer (optional, nur wenn io-channels im Device Tree gesetzt ist) */
+static unsigned int iio_batch_ms = 100;
+module_param(iio_batch_ms, uint, 0644);
+MODULE_PARM_DESC(iio_batch_ms, "Maximale Zeit, die IIO Samples gesammelt werden, bevor der Frame gesendet wird, in ms (Default: 100)");
+
+/* CRC-32/JAMCRC */
+static uint32_t calculate_crc(const uint8_t *data, size_t len)
+{
+    return crc32(0xFFFFFFFF, data, len);
+}
+
+// Probe function - Wird aufgerufen, wenn ein Gerät erkannt wird
+static int monitoring_sys_probe(struct platform_device *pdev);
+
+// Remove function - Wird aufgerufen wenn ein Gerät entfernt wird
+static int monitoring_sys_remove(struct platform_device *pdev);
+
+// Device Tree Match Tabelle
+static const struct of_device_id monitoring_sys_of_match[] = {
+    {.compatible = "embedded_linux,monitoring_system"},
+    {/* sentinel */}};
+MODULE_DEVICE_TABLE(of, monitoring_sys_of_match);
+
+// SPI ID Tabelle, für das Laden per SPI Modalias
+static const struct spi_device_id monitoring_sys_spi_ids[] = {
+    {"monitoring_system", 0},
+    {/* sentinel */}};
+MODULE_DEVICE_TABLE(spi, monitoring_sys_spi_ids);
+
+// GPIO-Variablen
+struct gpio_descs *msd_lanes = NULL; // Alle Einträge von msd-gpio, msd ist immer der erste
+struct gpio_desc *msd = NULL;
+struct gpio_desc *msc = NULL;
+struct gpio_desc *msa = NULL;
+struct gpio_desc *msr = NULL;
+
+static int ready_irq = -1;
+static DECLARE_WAIT_QUEUE_HEAD(ready_wq);
+
+/*
+    Target Modus (Device Tree Property target-mode). msc ist ein Eingang, die Gegenstelle holt die Bits in ihrem
+    eigenen Tempo ab: Sie tastet msd mit der steigenden Flanke ab, mit jeder fallenden Flanke legt der Interrupt
+    Handler das nächste Bit aus dem vorab kodierten Puffer tgt_wave an. Auf Host Seite gibt es keine Delays.
+*/
+static bool target_mode;
+static int target_irq = -1;
+static uint8_t tgt_wave[(MAX_BUFFER_SIZE + 1) * 8]; // Wie tx_window[].data: Frame im Fenster-Modus mit Sequenzbyte
+static unsigned int tgt_bits;
+static unsigned int tgt_pos;
+static DECLARE_COMPLETION(tgt_done);
+
+/*
+    DDR Modus (Device Tree Property ddr-mode). Jede Flanke von msc überträgt ein Bit: Datenbit anlegen, t_setup_us
+    warten, msc umschalten, t_low_us warten. Damit entfällt die High-Phase pro Bit und der Durchsatz verdoppelt sich.
+*/
+static bool ddr_mode;
+
+/*
+    Manchester Modus (Device Tree Property manchester-mode). msc wird nicht benötigt, die Daten werden nach IEEE 802.3
+    auf msd kodiert (0 = high->low, 1 = low->high, je t_high_us pro Halbbit), der Empfänger gewinnt den Takt aus
+    den Flanken zurück. Jedem Frame geht ein Präambel-Byte voraus.
+*/
+static bool manchester_mode;
+
+/*
+    Parallelbetrieb: Hat msd-gpio mehrere Einträge, teilen sich die Empfänger msc und jeder hat seine eigene
+    Datenleitung. MONSYS_IOC_SEND_PARALLEL taktet für alle Leitungen gleichzeitig je einen eigenen Frame,
+    alle Datenleitungen werden pro Bit mit einem Array-Zugriff gesetzt. Normale write() Aufrufe gehen an Leitung 0.
+*/
+static uint8_t lane_buf[MONSYS_MAX_LANES][MAX_BUFFER_SIZE];
+static size_t lane_len[MONSYS_MAX_LANES];
+
+/*
+    Auftrag an die Sende-Engine. lanes == 0 überträgt buffer auf msd, sonst werden die Frames der gesetzten
+    Leitungen aus lane_buf parallel übertragen. tx_spinning ist gesetzt, solange die Spin Engine läuft.
+*/
+struct monitoring_sys_tx {
+    const uint8_t *buffer;
+    size_t len;
+    unsigned long lanes;
+    bool spin;
+    int ret;
+    struct kthread_work work;
+};
+
+static bool tx_spinning;
+
+/*
+    Sende-Backend, gewählt über die Device Tree Property transport ("gpio", "spi" oder "sim"). prepare fordert die
+    Ressourcen des Backends beim Probe an, release gibt sie wieder frei. transmit_frame führt einen Auftrag im
+    Sende-Thread aus, abort bringt die Leitungen nach einem fehlgeschlagenen Frame in den Ruhezustand und can_spin
+    meldet, ob die Spin Engine nutzbar ist. Die Statistik führt monitoring_sys_run() für jedes Backend gleich.
+*/
+struct monitoring_sys_stats {
+    unsigned long frames;
+    unsigned long bytes;
+    unsigned long errors;
+    u64 busy_ns;
+};
+
+struct monitoring_sys_transport {
+    const char *name;
+    int (*prepare)(struct device *dev);
+    void (*release)(void);
+    int (*transmit_frame)(struct monitoring_sys_tx *tx);
+    void (*abort)(void);
+    bool (*can_spin)(void);
+    struct monitoring_sys_stats stats;
+};
+
+static struct monitoring_sys_transport *ms_transport;
+
+/*
+    Liegen msd oder msc an einem schlafenden GPIO Controller (I2C/SPI Expander), wird über die _cansleep Funktionen
+    geschrieben. Im normalen Takt Modus werden dabei fallende Taktflanke und nächstes Datenbit mit einem einzigen
+    Array-Zugriff gesetzt, was Expander mit set_multiple als ein Schreiben des Port-Registers ausführen.
+*/
+static bool tx_cansleep;
+
+/*
+    SPI Backend. Das Protokoll entspricht SPI Mode 0 mit LSB first, liegt der Knoten unter einem SPI Controller
+    wird der fertige Frame inklusive CRC per spi_write() (mit DMA, falls der Controller es kann) ausgegeben.
+    msd/msc werden dann nicht benutzt, Bitbashing bleibt das Backend für Knoten unter dem Root-Knoten.
+*/
+static struct spi_device *ms_spi;
+static uint8_t *spi_buf;   // Per kmalloc, Stack und Moduldaten sind nicht DMA-fähig
+static bool spi_swap_bits; // Controller kann kein SPI_LSB_FIRST
+
+/*
+    Eigener Sende-Thread, damit das Bitbashing nicht mit der Priorität und auf der CPU des aufrufenden Prozesses
+    läuft. Priorität (tx_priority) und CPU Affinität (tx_cpus) sind über sysfs einstellbar. Ist die Spin Engine
+    aktiv, wird der Thread für die Dauer auf spin_cpu festgelegt (tx_worker_cpu), sonst gilt tx_cpus.
+*/
+static struct kthread_worker *tx_worker;
+static struct cpumask tx_cpus;
+static int tx_worker_cpu = -1;
+static const char * const tx_priorities[] = { "normal", "fifo_low", "fifo" };
+static int tx_priority = 2;
+
+// Beim Probe gemessene Dauer eines gpiod_set_value Aufrufs auf msd bzw. msc in ns
+static unsigned int msd_cost_ns;
+static unsigned int msc_cost_ns;
+
+/*
+    Empfangspfad. Die Gegenstelle taktet auf rxc, mit jeder steigenden Flanke wird rxd LSB first abgetastet.
+    Ein Frame ist abgeschlossen, wenn rx_idle_us lang keine Flanke mehr kam. Frames mit gültigem CRC werden ohne
+    CRC als Datensatz in rx_fifo abgelegt und über read()/poll() auf /proc/monitoring-system ausgeliefert.
+*/
+struct gpio_desc *rxc = NULL;
+struct gpio_desc *rxd = NULL;
+
+static int rx_irq = -1;
+static struct hrtimer rx_timer;
+static DEFINE_SPINLOCK(rx_lock);
+static uint8_t rx_buf[MAX_BUFFER_SIZE];
+static size_t rx_len;
+static unsigned int rx_bits;
+static bool rx_overflow;
+
+typedef STRUCT_KFIFO_REC_2(RX_FIFO_SIZE) monitoring_sys_rx_fifo_t;
+static monitoring_sys_rx_fifo_t rx_fifo;
+static DECLARE_WAIT_QUEUE_HEAD(rx_wq);
+static DEFINE_MUTEX(rx_read_lock);
+static bool rx_gone; // Gerät wird entfernt, wartende read() Aufrufe kehren mit -ENODEV zurück
+
+/*
+    Anfrage/Antwort Transaktionen (MONSYS_IOC_TRANSACT). Solange txn_addr >= 0 ist, wird ein gültiger Frame mit dieser
+    Adresse nicht in rx_fifo gelegt, sondern als Antwort an den wartenden ioctl übergeben. Ist nur rxc-gpio
+    vorhanden, läuft der Empfang halbduplex über msd, das dafür während der Transaktion auf Eingang geschaltet wird.
+    txn_lock serialisiert die Transaktionen. tx_lock wird nur im Halbduplex Betrieb über das Warten auf die Antwort
+    gehalten, mit eigener rxd Leitung läuft das Senden anderer Frames währenddessen weiter.
+*/
+static DEFINE_MUTEX(txn_lock);
+static bool rx_half_duplex;
+static DECLARE_COMPLETION(txn_done);
+static int txn_addr = -1;
+static uint8_t txn_buf[MAX_BUFFER_SIZE];
+static size_t txn_len;
+static unsigned long txn_hist[TXN_HIST_BUCKETS];
+static unsigned long txn_timeouts;
+
+static unsigned long rx_frames;
+static unsigned long rx_crc_errors;
+static unsigned long rx_dropped;
+
+static int ack_irq = -1;
+static DECLARE_WAIT_QUEUE_HEAD(ack_wq);
+static DEFINE_SPINLOCK(ack_lock);
+static unsigned int ack_count;
+static unsigned int nack_count;
+static ktime_t ack_rise;
+
+/*
+    Sendefenster für den Fenster-Modus (window_size > 1).
+    Jeder Frame erhält vor dem CRC ein Sequenzbyte (7 Bit Nummer + Resync Flag) und bleibt als Kopie im Fenster,
+    bis der Empfänger ihn quittiert hat. Der Empfänger quittiert nur Frames in der erwarteten Reihenfolge, jeder
+    ACK Puls bestätigt also den ältesten offenen Frame. Frames mit falscher Sequenznummer verwirft er ohne Puls,
+    einen CRC Fehler meldet er mit NACK. Bei NACK oder Timeout wird ab dem ältesten offenen Frame wiederholt (Go-Back-N).
+*/
+// Herkunft eines Frames, bestimmt wohin ein Sendefehler gemeldet wird
+enum monitoring_sys_origin {
+    MONSYS_FROM_WRITE,  // write(), Fehler landet in queue_error
+    MONSYS_FROM_KERNEL, // monsys_submit(), Sampler, IIO und Thermal, Fehler zählt producer_errors
+    MONSYS_FROM_TXN,    // MONSYS_IOC_TRANSACT, Fehler kommt als Rückgabewert bzw. Timeout zurück
+};
+
+struct monitoring_sys_frame {
+    uint8_t data[MAX_BUFFER_SIZE + 1];
+    size_t len;
+    enum monitoring_sys_origin origin;
+    unsigned int attempts;
+    ktime_t sent;
+};
+
+static struct monitoring_sys_frame tx_window[MAX_WINDOW_SIZE];
+static unsigned int win_head;
+static unsigned int win_count;
+static uint8_t tx_seq;
+static bool tx_resync = true;
+
+static void monitoring_sys_window_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(window_work, monitoring_sys_window_work_fn);
+
+/*
+    Zustand der Bitraten-Anpassung. rate_ceiling ist die niedrigste Stufe, die zuletzt wegen zu vieler Fehler
+    verlassen wurde. Sie wird erst nach längerer fehlerfreier Zeit erneut probiert.
+*/
+static unsigned int rate_level;
+static unsigned int rate_ceiling = RATE_MAX_LEVEL + 1;
+static unsigned int rate_good;
+static unsigned int rate_fail_run;
+static unsigned int rate_frames;
+static unsigned int rate_errors;
+
+// Serialisiert den Zugriff auf msd/msc, parallele write()-Aufrufe würden sonst ihre Bits vermischen
+static DEFINE_MUTEX(tx_lock);
+
+/*
+    Frame-Puffer für write() und Transaktionen. Die Puffer kommen aus einem eigenen kmem_cache, der mempool hält
+    queue_depth davon in Reserve. Angefordert wird mit GFP_NOWAIT: Ist weder der Cache noch die Reserve sofort
+    verfügbar, bekommt der Aufrufer -EAGAIN, statt unter Speicherdruck im Reclaim zu warten.
+*/
+struct monitoring_sys_buf {
+    struct list_head node;
+    size_t len;
+    enum monitoring_sys_origin origin;
+    uint8_t data[MAX_BUFFER_SIZE];
+};
+
+static struct kmem_cache *frame_cache;
+static mempool_t *frame_pool;
+
+/*
+    Sendewarteschlange. write() hängt den Frame an tx_queue an, weckt per queue_work() den Sende-Work und kehrt
+    sofort zurück. Der Work arbeitet die Warteschlange ab und endet, sobald sie leer ist: Ohne Frames gibt es weder
+    Timer noch Wakeups. queue_len zählt wartende Frames inklusive des gerade gesendeten, queue_wq wird bei jedem
+    fertigen Frame geweckt. Ein Sendefehler eines Frames aus write() wird in queue_error gemerkt und vom nächsten
+    write() gemeldet, Fehler bei Frames der Kernel Produzenten zählt producer_errors.
+    queue_lock wird auch aus monsys_submit() im Softirq genommen, daher überall mit _bh. queue_open ist gesetzt,
+    solange ein Gerät gebunden ist und Frames angenommen werden.
+*/
+static LIST_HEAD(tx_queue);
+static DEFINE_SPINLOCK(queue_lock);
+static bool queue_open;
+static unsigned int queue_len;
+static DECLARE_WAIT_QUEUE_HEAD(queue_wq);
+static int queue_error;
+static unsigned long producer_errors; // Geschützt durch queue_lock
+static void monitoring_sys_queue_work_fn(struct work_struct *work);
+static DECLARE_WORK(queue_work, monitoring_sys_queue_work_fn);
+
+/*
+    Runtime PM. Nach autosuspend_ms ohne Übertragung wird das Gerät suspendiert und die Pins in den pinctrl
+    Zustand "sleep" gebracht, vor der nächsten Übertragung wieder in "default". Die Dauer eines echten Resume,
+    gemessen vom Anfordern bis zur Bereitschaft, steht in sysfs pm_resume_latency.
+*/
+static struct device *ms_dev;
+static bool pm_resumed;
+static unsigned long pm_resume_count;
+static unsigned int pm_resume_last_us;
+static unsigned int pm_resume_max_us;
+
+static struct proc_dir_entry *proc_file = NULL;
+
+
+/*
+    Interrupt Handler für die ack-gpio Leitung (steigende und fallende Flanke).
+    Der Empfänger quittiert jeden Frame nach dem CRC mit einem Puls: ein kurzer Puls bedeutet ACK,
+    ein Puls der länger als nack_pulse_us ist bedeutet NACK (CRC Fehler beim Empfänger).
+*/
+static irqreturn_t monitoring_sys_ack_irq(int irq, void *dev_id)
+{
+    ktime_t now = ktime_get();
+    unsigned long flags;
+
+    spin_lock_irqsave(&ack_lock, flags);
+    if (gpiod_get_value(msa))
+    {
+        ack_rise = now;
+    }
+    else if (ack_rise)
+    {
+        if (ktime_us_delta(now, ack_rise) < nack_pulse_us)
+            ack_count++;
+        else
+            nack_count++;
+        ack_rise = 0;
+    }
+    spin_unlock_irqrestore(&ack_lock, flags);
+
+    wake_up(&ack_wq);
+    return IRQ_HANDLED;
+}
+
+// Setzt die Quittierungszähler vor dem Senden eines Frames zurück
+static void monitoring_sys_reset_ack(void)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&ack_lock, flags);
+    ack_count = 0;
+    nack_count = 0;
+    ack_rise = 0;
+    spin_unlock_irqrestore(&ack_lock, flags);
+}
+
+/*
+    Wartet nach dem Senden eines Frames auf die Quittierung des Empfängers.
+    Gibt 0 bei ACK, -EBADMSG bei NACK und -ETIMEDOUT zurück, wenn innerhalb von ack_timeout_us kein Puls kam.
+*/
+static int monitoring_sys_wait_ack(void)
+{
+    int ret;
+
+    ret = wait_event_hrtimeout(ack_wq, READ_ONCE(ack_count) || READ_ONCE(nack_count),
+                               us_to_ktime(ack_timeout_us));
+    if (ret)
+        return -ETIMEDOUT;
+    if (READ_ONCE(nack_count))
+        return -EBADMSG;
+    return 0;
+}
+
+// Rechnet eine konfigurierte Zeit in us auf die aktuelle Bitraten-Stufe um
+static unsigned int monitoring_sys_scale(unsigned int us)
+{
+    return max(us >> rate_level, 1U);
+}
+
+// Bitrate in Bit/s, die sich aus dem aktuellen Timing ergibt
+static unsigned int monitoring_sys_bit_rate(void)
+{
+    if (ms_spi)
+        return ms_spi->max_speed_hz;
+    if (manchester_mode)
+        return USEC_PER_SEC / (2 * monitoring_sys_scale(t_high_us));
+    if (ddr_mode)
+        return USEC_PER_SEC / (monitoring_sys_scale(t_setup_us) + monitoring_sys_scale(t_low_us));
+    return USEC_PER_SEC / (monitoring_sys_scale(t_setup_us) + monitoring_sys_scale(t_high_us) +
+                           monitoring_sys_scale(t_low_us));
+}
+
+static void monitoring_sys_set_rate_level(unsigned int level)
+{
+    rate_level = level;
+    rate_good = 0;
+    rate_fail_run = 0;
+    rate_frames = 0;
+    rate_errors = 0;
+    pr_info("monitoring-sys: Bit rate level %u, %u bit/s\n", level, monitoring_sys_bit_rate());
+}
+
+/*
+    Rückmeldung über einen gesendeten Frame (ok = ACK, sonst NACK oder Timeout) für die automatische Bitraten-Anpassung.
+    Nach rate_up_after fehlerfreien Frames wird die nächst schnellere Stufe probiert. Liegt die Fehlerrate über
+    RATE_EVAL_FRAMES Frames über rate_error_pct, oder schlagen RATE_FAIL_RUN Frames in Folge fehl, wird auf die
+    langsamere Stufe zurückgeschaltet und die fehlerhafte Stufe gesperrt, bis 8 * rate_up_after Frames fehlerfrei waren.
+    Muss mit tx_lock aufgerufen werden.
+*/
+static void monitoring_sys_rate_feedback(bool ok)
+{
+    if (!adaptive_rate)
+        return;
+
+    rate_frames++;
+    if (ok)
+    {
+        rate_good++;
+        rate_fail_run = 0;
+    }
+    else
+    {
+        rate_errors++;
+        rate_good = 0;
+        rate_fail_run++;
+    }
+
+    if (rate_level > 0 && (rate_fail_run >= RATE_FAIL_RUN ||
+        (rate_frames >= RATE_EVAL_FRAMES && rate_errors * 100 > rate_error_pct * rate_frames)))
+    {
+        rate_ceiling = rate_level;
+        monitoring_sys_set_rate_level(rate_level - 1);
+        return;
+    }
+
+    if (rate_good >= 8 * rate_up_after)
+        rate_ceiling = RATE_MAX_LEVEL + 1;
+    if (rate_good >= rate_up_after && rate_level + 1 < rate_ceiling)
+    {
+        monitoring_sys_set_rate_level(rate_level + 1);
+        return;
+    }
+
+    if (rate_frames >= RATE_EVAL_FRAMES)
+    {
+        rate_frames = 0;
+        rate_errors = 0;
+    }
+}
+
+static ssize_t bit_rate_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%u\n", monitoring_sys_bit_rate());
+}
+static DEVICE_ATTR_RO(bit_rate);
+
+static ssize_t rate_level_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%u\n", rate_level);
+}
+static DEVICE_ATTR_RO(rate_level);
+
+// Interrupt Handler für die ready-gpio Leitung, weckt einen auf den Empfänger wartenden Sendevorgang
+static irqreturn_t monitoring_sys_ready_irq(int irq, void *dev_id)
+{
+    wake_up(&ready_wq);
+    return IRQ_HANDLED;
+}
+
+/*
+    Wartet, solange der Empfänger über ready-gpio "busy" meldet. Ohne ready-gpio kehrt die Funktion sofort zurück.
+    Gibt -ETIMEDOUT zurück, wenn der Empfänger länger als ready_timeout_ms beschäftigt ist.
+*/
+static int monitoring_sys_wait_ready(void)
+{
+    if (!msr || gpiod_get_value(msr))
+        return 0;
+
+    if (!wait_event_timeout(ready_wq, gpiod_get_value(msr), msecs_to_jiffies(ready_timeout_ms)))
+    {
+        pr_err("monitoring-sys: Receiver busy for more than %u ms\n", ready_timeout_ms);
+        return -ETIMEDOUT;
+    }
+    return 0;
+}
+
+// Interrupt Handler für die fallende Flanke auf msc im Target Modus, legt das nächste Datenbit an
+static irqreturn_t monitoring_sys_target_irq(int irq, void *dev_id)
+{
+    if (tgt_pos < tgt_bits)
+    {
+        gpiod_set_value(msd, tgt_wave[tgt_pos++]);
+    }
+    else if (tgt_pos == tgt_bits)
+    {
+        // Die Gegenstelle hat das letzte Bit abgetastet
+        tgt_pos++;
+        gpiod_set_value(msd, 0);
+        complete(&tgt_done);
+    }
+    return IRQ_HANDLED;
+}
+
+/*
+    Überträgt einen Frame im Target Modus. Der Frame wird vorab in ein Bit pro Byte kodiert, das erste Bit angelegt
+    und anschließend gewartet, bis die Gegenstelle alle Bits über msc abgeholt hat.
+*/
+static int monitoring_sys_transmit_target(const uint8_t *buffer, size_t len)
+{
+    long left;
+
+    if (len * 8 > ARRAY_SIZE(tgt_wave))
+        return -EINVAL;
+
+    for (size_t i = 0; i < len * 8; i++)
+        tgt_wave[i] = (buffer[i / 8] >> (i % 8)) & 1;
+    tgt_bits = len * 8;
+    tgt_pos = 1;
+
+    reinit_completion(&tgt_done);
+    gpiod_set_value(msd, tgt_wave[0]);
+    enable_irq(target_irq);
+
+    left = wait_for_completion_interruptible_timeout(&tgt_done, msecs_to_jiffies(target_timeout_ms));
+    disable_irq(target_irq);
+    if (left > 0)
+        return 0;
+
+    gpiod_set_value(msd, 0);
+    if (!left)
+    {
+        pr_err("monitoring-sys: Target mode: peer fetched %u of %u bits before timeout\n", tgt_pos - 1, tgt_bits);
+        return -ETIMEDOUT;
+    }
+    return left;
+}
+
+// Setzt eine Sendeleitung, auf schlafenden Controllern über die _cansleep Variante
+static void monitoring_sys_set(struct gpio_desc *desc, int value)
+{
+    if (tx_cansleep)
+        gpiod_set_value_cansleep(desc, value);
+    else
+        gpiod_set_value(desc, value);
+}
+
+// Setzt alle Datenleitungen im Parallelbetrieb mit einem Array-Zugriff
+static void monitoring_sys_set_lanes(unsigned long *values)
+{
+    if (tx_cansleep)
+        gpiod_set_array_value_cansleep(msd_lanes->ndescs, msd_lanes->desc, msd_lanes->info, values);
+    else
+        gpiod_set_array_value(msd_lanes->ndescs, msd_lanes->desc, msd_lanes->info, values);
+}
+
+// Wartet aktiv, bis ns Nanosekunden vergangen sind
+static void monitoring_sys_spin(unsigned int ns)
+{
+    ktime_t end = ktime_add_ns(ktime_get(), ns);
+
+    while (ktime_before(ktime_get(), end))
+        cpu_relax();
+}
+
+/*
+    Wartet ns Nanosekunden zwischen zwei Flanken. In der Spin Engine wird immer aktiv gewartet. Sonst wird nur
+    für Delays ab delay_threshold_us geschlafen, kürzere Delays würden durch die Verspätung beim Aufwachen
+    ein Vielfaches länger dauern und werden deshalb ebenfalls aktiv gewartet.
+*/
+static void monitoring_sys_delay(unsigned int ns)
+{
+    if (!ns)
+        return;
+    if (tx_spinning || (s64)ns < (s64)READ_ONCE(delay_threshold_us) * NSEC_PER_USEC)
+        monitoring_sys_spin(ns);
+    else
+        usleep_range(ns / NSEC_PER_USEC, ns / NSEC_PER_USEC);
+}
+
+// Rechnet eine Phase in us auf die aktuelle Bitraten-Stufe um und zieht die Dauer des vorangehenden GPIO Zugriffs ab
+static unsigned int monitoring_sys_phase_ns(unsigned int us, unsigned int cost_ns)
+{
+    unsigned int ns = monitoring_sys_scale(us) * NSEC_PER_USEC;
+
+    if (!toggle_compensation)
+        return ns;
+    return ns > cost_ns ? ns - cost_ns : 0;
+}
+
+/*
+    Liefert die Delays eines Bits in ns. Vor der Setup-Zeit wird msd geschrieben, vor High- und Low-Phase msc,
+    deren gemessene Zugriffszeit jeweils abgezogen wird, damit die erreichte Bitrate der konfigurierten entspricht.
+*/
+static void monitoring_sys_bit_timing(unsigned int *setup, unsigned int *high, unsigned int *low)
+{
+    *setup = monitoring_sys_phase_ns(t_setup_us, msd_cost_ns);
+    *high = monitoring_sys_phase_ns(t_high_us, msc_cost_ns);
+    *low = monitoring_sys_phase_ns(t_low_us, msc_cost_ns);
+}
+
+/*
+    Misst die mittlere Dauer eines Schreibzugriffs auf eine Ausgangsleitung in ns. msd wird dabei getoggelt,
+    was bei ruhendem msc für den Empfänger unsichtbar ist. msc wird nur mit seinem Ruhepegel beschrieben,
+    damit keine Taktflanken entstehen. Im Manchester Modus ist jede Flanke auf msd ein Datum und im Target Modus
+    taktet die Gegenstelle msc womöglich gerade, dort wird msd ebenfalls nur mit dem Ruhepegel beschrieben.
+*/
+static unsigned int monitoring_sys_measure_toggle(struct gpio_desc *desc, bool toggle)
+{
+    ktime_t start;
+    int val = 0;
+    s64 ns;
+
+    start = ktime_get();
+    for (int i = 0; i < TOGGLE_CAL_SAMPLES; i++) {
+        if (toggle)
+            val = !val;
+        gpiod_set_value_cansleep(desc, val);
+    }
+    ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+    gpiod_set_value_cansleep(desc, 0);
+    return div_s64(ns, TOGGLE_CAL_SAMPLES);
+}
+
+// Misst beim Probe die Toggle-Kosten von msd und msc (msc nur, wenn der Treiber es als Ausgang treibt)
+static void monitoring_sys_calibrate_toggle(void)
+{
+    msd_cost_ns = monitoring_sys_measure_toggle(msd, !manchester_mode && !target_mode);
+    msc_cost_ns = (msc && !target_mode) ? monitoring_sys_measure_toggle(msc, false) : 0;
+    pr_info("monitoring-sys: GPIO write cost msd %u ns, msc %u ns\n", msd_cost_ns, msc_cost_ns);
+}
+
+static ssize_t toggle_cost_ns_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "msd %u\nmsc %u\n", msd_cost_ns, msc_cost_ns);
+}
+static DEVICE_ATTR_RO(toggle_cost_ns);
+
+/*
+    Misst beim Probe, wie viel später als angefordert ein kurzer usleep_range zurückkehrt. Delays, die kürzer als
+    das Doppelte dieser Verspätung sind, werden danach aktiv gewartet.
+*/
+static void monitoring_sys_calibrate_delay(void)
+{
+    ktime_t start;
+    s64 late = 0;
+
+    for (int i = 0; i < DELAY_CAL_SAMPLES; i++) {
+        start = ktime_get();
+        usleep_range(DELAY_CAL_US, DELAY_CAL_US);
+        late += ktime_us_delta(ktime_get(), start) - DELAY_CAL_US;
+    }
+    delay_threshold_us = 2 * max_t(s64, div_s64(late, DELAY_CAL_SAMPLES), 0);
+    pr_info("monitoring-sys: Sleeping delays below %d us are replaced by spinning\n", delay_threshold_us);
+}
+
+/*
+    Taktet ein bereits auf msd angelegtes Datenbit. Normal: t_setup warten, msc high, t_high warten, msc low,
+    t_low warten (im DDR Modus wird msc nur umgeschaltet). Mit coalesce_delays wird die Low-Phase mit der
+    Setup-Zeit des nächsten Bits zusammengelegt, das spart ein Delay pro Bit (im DDR Modus bleibt nur eines).
+    Das setzt voraus, dass der Empfänger keine Haltezeit nach der Flanke braucht.
+*/
+static void monitoring_sys_clock_bit(int *clk, unsigned int setup, unsigned int high, unsigned int low)
+{
+    if (coalesce_delays)
+    {
+        monitoring_sys_delay(setup + low);
+        if (ddr_mode)
+        {
+            *clk = !*clk;
+            monitoring_sys_set(msc, *clk);
+            return;
+        }
+        monitoring_sys_set(msc, 1);
+        monitoring_sys_delay(high);
+        monitoring_sys_set(msc, 0);
+        return;
+    }
+
+    monitoring_sys_delay(setup);
+    if (ddr_mode)
+    {
+        *clk = !*clk;
+        monitoring_sys_set(msc, *clk);
+        monitoring_sys_delay(low);
+        return;
+    }
+    monitoring_sys_set(msc, 1);
+    monitoring_sys_delay(high);
+    monitoring_sys_set(msc, 0);
+    monitoring_sys_delay(low);
+}
+
+static ssize_t delay_threshold_us_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%d\n", delay_threshold_us);
+}
+
+static ssize_t delay_threshold_us_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    int val;
+    int ret = kstrtoint(buf, 0, &val);
+
+    if (ret)
+        return ret;
+    if (val < 0)
+        monitoring_sys_calibrate_delay();
+    else
+        WRITE_ONCE(delay_threshold_us, val);
+    return count;
+}
+static DEVICE_ATTR_RW(delay_threshold_us);
+
+/*
+    Wird vor jedem Byte i eines Frames aufgerufen. Wartet bei Bedarf auf ready-gpio und gibt in der Spin Engine
+    nach jeweils spin_burst_bytes Bytes kurz die Präemption frei (cond_resched), damit die CPU nicht für einen
+    ganzen Frame blockiert ist. Der Empfänger wird über msc getaktet, eine Pause zwischen zwei Bytes stört ihn nicht.
+*/
+static int monitoring_sys_byte_start(size_t i)
+{
+    bool ready = msr && (i == 0 || ready_per_byte);
+    bool burst_end = tx_spinning && i && i % READ_ONCE(spin_burst_bytes) == 0;
+    int ret = 0;
+
+    if (!ready && !burst_end)
+        return 0;
+
+    if (tx_spinning)
+        preempt_enable();
+    if (ready)
+        ret = monitoring_sys_wait_ready();
+    if (tx_spinning)
+    {
+        cond_resched();
+        preempt_disable();
+    }
+    return ret;
+}
+
+// Gibt ein Byte LSB first Manchester kodiert auf msd aus
+static void monitoring_sys_manchester_byte(uint8_t byte, unsigned int half)
+{
+    for (int j = 0; j < 8; j++) {
+        int bit = (byte >> j) & 1;
+
+        monitoring_sys_set(msd, !bit);
+        monitoring_sys_delay(half);
+        monitoring_sys_set(msd, bit);
+        monitoring_sys_delay(half);
+    }
+}
+
+/*
+    Überträgt einen Frame im Manchester Modus nur über msd. Auf ready-gpio wird nur vor dem Frame gewartet und
+    die Spin Engine macht keine Burst-Pausen, eine Pause mitten im Frame würde die Taktrückgewinnung stören.
+*/
+static int monitoring_sys_transmit_manchester(const uint8_t *buffer, size_t len)
+{
+    unsigned int half = monitoring_sys_phase_ns(t_high_us, msd_cost_ns);
+    int ret;
+
+    ret = monitoring_sys_byte_start(0);
+    if (ret)
+        return ret;
+
+    monitoring_sys_manchester_byte(MANCHESTER_PREAMBLE, half);
+    for (size_t i = 0; i < len; i++)
+        monitoring_sys_manchester_byte(buffer[i], half);
+    monitoring_sys_set(msd, 0);
+    return 0;
+}
+
+/*
+    Taktet die Frames der in lanes gesetzten Leitungen gleichzeitig aus, alle müssen len Bytes lang sein.
+    Die übrigen Datenleitungen bleiben low. Muss mit tx_lock aufgerufen werden.
+*/
+static int monitoring_sys_transmit_lanes(unsigned long lanes, size_t len)
+{
+    unsigned int setup, high, low;
+    unsigned long values = 0;
+    unsigned int lane;
+    int clk = 0;
+    int ret = 0;
+
+    monitoring_sys_bit_timing(&setup, &high, &low);
+    for (size_t i = 0; i < len; i++) {
+        ret = monitoring_sys_byte_start(i);
+        if (ret)
+            break;
+        for (int j = 0; j < 8; j++) {
+            values = 0;
+            for_each_set_bit(lane, &lanes, msd_lanes->ndescs)
+                if ((lane_buf[lane][i] >> j) & 1)
+                    __set_bit(lane, &values);
+            monitoring_sys_set_lanes(&values);
+            monitoring_sys_clock_bit(&clk, setup, high, low);
+        }
+    }
+    values = 0;
+    monitoring_sys_set_lanes(&values);
+    return ret;
+}
+
+/*
+    Überträgt einen fertigen Frame (inklusive CRC) per Bitbashing über msd/msc.
+    Die Bits werden LSB first ausgegeben, der Empfänger übernimmt das Datenbit mit der steigenden Flanke von msc
+    (im DDR Modus mit jeder Flanke, da ein Frame aus ganzen Bytes besteht endet msc wieder auf low).
+    Ist ready-gpio vorhanden, wird vor dem Frame (bzw. mit ready_per_byte vor jedem Byte) gewartet, bis der
+    Empfänger bereit ist. Dadurch kann das Bit Timing kürzer als für den langsamsten Fall gewählt werden.
+*/
+static int monitoring_sys_transmit_bitbang(const uint8_t *buffer, size_t len)
+{
+    unsigned int setup, high, low;
+    int clk = 0;
+    int ret;
+
+    monitoring_sys_bit_timing(&setup, &high, &low);
+    for (int i = 0; i < len; i++) {
+        ret = monitoring_sys_byte_start(i);
+        if (ret)
+        {
+            monitoring_sys_set(msd, 0);
+            return ret;
+        }
+        pr_debug("monitoring-sys: kernel_buffer[%d] = 0x%02X\n", i, buffer[i]);
+        for (int j = 0; j < 8; j++) {
+            monitoring_sys_set(msd, (buffer[i] >> j) & 1);
+            monitoring_sys_clock_bit(&clk, setup, high, low);
+        }
+    }
+    monitoring_sys_set(msd, 0);
+    return 0;
+}
+
+/*
+    Überträgt einen Frame über schlafende GPIO Controller. Pro Bit werden nur zwei Bus-Transaktionen erzeugt:
+    msc low und neues Datenbit gemeinsam, danach msc high. Das Datenbit wechselt so mit der fallenden Flanke,
+    eine halbe Periode vor der Abtastung durch den Empfänger. Abgezogen werden nur die zwei tatsächlichen
+    Zugriffe: der Array-Zugriff (ein Schreiben des Port-Registers, etwa so teuer wie msd allein) von der
+    zusammengelegten Low- und Setup-Phase, der Zugriff auf msc von der High-Phase.
+*/
+static int monitoring_sys_transmit_batched(const uint8_t *buffer, size_t len)
+{
+    struct gpio_desc *pins[2] = { msd, msc };
+    unsigned int setup, high, gap;
+    unsigned long values;
+    int ret = 0;
+
+    setup = monitoring_sys_phase_ns(t_setup_us, msd_cost_ns);
+    high = monitoring_sys_phase_ns(t_high_us, msc_cost_ns);
+    gap = monitoring_sys_phase_ns(t_setup_us, 0) + monitoring_sys_phase_ns(t_low_us, 0);
+    if (toggle_compensation)
+        gap = gap > msd_cost_ns ? gap - msd_cost_ns : 0;
+
+    for (size_t i = 0; i < len; i++) {
+        ret = monitoring_sys_byte_start(i);
+        if (ret)
+            break;
+        for (int j = 0; j < 8; j++) {
+            values = (buffer[i] >> j) & 1;
+            gpiod_set_array_value_cansleep(2, pins, NULL, &values);
+            monitoring_sys_delay(i || j ? gap : setup);
+            gpiod_set_value_cansleep(msc, 1);
+            monitoring_sys_delay(high);
+        }
+    }
+    values = 0;
+    gpiod_set_array_value_cansleep(2, pins, NULL, &values);
+    return ret;
+}
+
+// transmit_frame des GPIO Backends, wählt die passende Bitbashing Variante
+static int monitoring_sys_gpio_transmit(struct monitoring_sys_tx *tx)
+{
+    if (target_mode)
+        return monitoring_sys_transmit_target(tx->buffer, tx->len);
+    if (tx->lanes)
+        return monitoring_sys_transmit_lanes(tx->lanes, tx->len);
+    if (manchester_mode)
+        return monitoring_sys_transmit_manchester(tx->buffer, tx->len);
+    if (tx_cansleep && !ddr_mode)
+        return monitoring_sys_transmit_batched(tx->buffer, tx->len);
+    return monitoring_sys_transmit_bitbang(tx->buffer, tx->len);
+}
+
+// abort des GPIO Backends, legt alle Datenleitungen und msc nach einem abgebrochenen Frame wieder auf low
+static void monitoring_sys_gpio_abort(void)
+{
+    DECLARE_BITMAP(values, MONSYS_MAX_LANES) = { 0 };
+
+    if (target_mode)
+    {
+        monitoring_sys_set(msd, 0);
+        return;
+    }
+    gpiod_set_array_value_cansleep(msd_lanes->ndescs, msd_lanes->desc, msd_lanes->info, values);
+    if (msc)
+        gpiod_set_value_cansleep(msc, 0);
+}
+
+/*
+    can_spin des GPIO Backends: Die Spin Engine braucht nicht schlafende GPIOs und einen eigenen Takt. Manchester
+    überträgt einen Frame ohne Pause zwischen den Bytes, dort kann die Präemption nicht nach spin_burst_bytes
+    freigegeben werden.
+*/
+static bool monitoring_sys_gpio_can_spin(void)
+{
+    return !tx_cansleep && !target_mode && !manchester_mode;
+}
+
+// transmit_frame des SPI Backends, auf ready-gpio wird vor dem Frame gewartet
+static int monitoring_sys_spi_transmit(struct monitoring_sys_tx *tx)
+{
+    int ret;
+
+    ret = monitoring_sys_byte_start(0);
+    if (ret)
+        return ret;
+
+    for (size_t i = 0; i < tx->len; i++)
+        spi_buf[i] = spi_swap_bits ? bitrev8(tx->buffer[i]) : tx->buffer[i];
+    return spi_write(ms_spi, spi_buf, tx->len);
+}
+
+/*
+    transmit_frame des Simulations-Backends. Es werden keine Leitungen angesteuert, der Frame belegt den Sende-Thread
+    nur so lange, wie er bei der eingestellten Bitrate auf der Leitung bräuchte. Damit lassen sich Warteschlange,
+    Fenster und Front-End ohne Hardware testen und mit den echten Backends vergleichen.
+*/
+static int monitoring_sys_sim_transmit(struct monitoring_sys_tx *tx)
+{
+    unsigned int rate;
+    u64 airtime_ns;
+    int ret;
+
+    ret = monitoring_sys_byte_start(0);
+    if (ret)
+        return ret;
+
+    // Unter 1 Bit/s liefert monitoring_sys_bit_rate() 0, lange Frames passen nicht in die ns des normalen Delays
+    rate = max(monitoring_sys_bit_rate(), 1U);
+    airtime_ns = div_u64((u64)tx->len * 8 * NSEC_PER_SEC, rate);
+    if (airtime_ns <= UINT_MAX)
+        monitoring_sys_delay(airtime_ns);
+    else
+        fsleep(div_u64(airtime_ns, NSEC_PER_USEC));
+    return 0;
+}
+
+// Läuft im Sende-Thread und führt den Auftrag aus, mit der Spin Engine ohne Präemption
+static void monitoring_sys_tx_work_fn(struct kthread_work *work)
+{
+    struct monitoring_sys_tx *tx = container_of(work, struct monitoring_sys_tx, work);
+
+    if (tx->spin)
+    {
+        tx_spinning = true;
+        preempt_disable();
+    }
+    tx->ret = ms_transport->transmit_frame(tx);
+    if (tx->spin)
+    {
+        preempt_enable();
+        tx_spinning = false;
+    }
+
+    if (tx->ret && ms_transport->abort)
+        ms_transport->abort();
+}
+
+// Legt den Sende-Thread auf cpu fest, bzw. mit cpu < 0 wieder auf tx_cpus. Muss mit tx_lock aufgerufen werden.
+static void monitoring_sys_pin_worker(int cpu)
+{
+    if (cpu == tx_worker_cpu)
+        return;
+    set_cpus_allowed_ptr(tx_worker->task, cpu >= 0 ? cpumask_of(cpu) : &tx_cpus);
+    tx_worker_cpu = cpu;
+}
+
+/*
+    Übergibt einen Sendeauftrag an den Sende-Thread und wartet auf das Ergebnis. Mit spin_cpu >= 0 läuft die
+    Übertragung auf dieser CPU (idealerweise per isolcpus reserviert) mit aktivem Warten, was Bitperioden unter
+    10 us erlaubt, sofern das Backend sie unterstützt. Muss mit tx_lock aufgerufen werden.
+*/
+static int monitoring_sys_run(struct monitoring_sys_tx *tx)
+{
+    struct monitoring_sys_stats *stats = &ms_transport->stats;
+    int cpu = READ_ONCE(spin_cpu);
+    ktime_t start;
+
+    if (cpu >= 0 && (cpu >= nr_cpu_ids || !cpu_online(cpu) || !ms_transport->can_spin ||
+                     !ms_transport->can_spin()))
+    {
+        pr_warn_once("monitoring-sys: spin_cpu %d not usable, using the sleeping engine\n", cpu);
+        cpu = -1;
+    }
+    tx->spin = cpu >= 0;
+    monitoring_sys_pin_worker(cpu);
+
+    start = ktime_get();
+    kthread_init_work(&tx->work, monitoring_sys_tx_work_fn);
+    kthread_queue_work(tx_worker, &tx->work);
+    kthread_flush_work(&tx->work);
+
+    stats->busy_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+    stats->frames++;
+    stats->bytes += tx->lanes ? tx->len * hweight_long(tx->lanes) : tx->len;
+    if (tx->ret)
+        stats->errors++;
+    return tx->ret;
+}
+
+// Setzt die Scheduling Klasse des Sende-Threads, sched_setscheduler() steht Modulen nicht zur Verfügung
+static void monitoring_sys_apply_priority(int prio)
+{
+    switch (prio) {
+    case 0:
+        sched_set_normal(tx_worker->task, 0);
+        break;
+    case 1:
+        sched_set_fifo_low(tx_worker->task);
+        break;
+    default:
+        sched_set_fifo(tx_worker->task);
+        break;
+    }
+    tx_priority = prio;
+}
+
+static ssize_t transport_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%s\n", ms_transport->name);
+}
+static DEVICE_ATTR_RO(transport);
+
+static ssize_t transport_stats_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    struct monitoring_sys_stats *stats = &ms_transport->stats;
+    int len = 0;
+
+    len += sysfs_emit_at(buf, len, "frames: %lu\n", stats->frames);
+    len += sysfs_emit_at(buf, len, "bytes: %lu\n", stats->bytes);
+    len += sysfs_emit_at(buf, len, "errors: %lu\n", stats->errors);
+    len += sysfs_emit_at(buf, len, "busy_us: %llu\n", div_u64(stats->busy_ns, NSEC_PER_USEC));
+    return len;
+}
+static DEVICE_ATTR_RO(transport_stats);
+
+static ssize_t tx_priority_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%s\n", tx_priorities[tx_priority]);
+}
+
+static ssize_t tx_priority_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    int prio = sysfs_match_string(tx_priorities, buf);
+
+    if (prio < 0)
+        return prio;
+    monitoring_sys_apply_priority(prio);
+    return count;
+}
+static DEVICE_ATTR_RW(tx_priority);
+
+static ssize_t tx_cpus_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%*pbl\n", cpumask_pr_args(&tx_cpus));
+}
+
+static ssize_t tx_cpus_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    cpumask_var_t mask;
+    int ret;
+
+    if (!alloc_cpumask_var(&mask, GFP_KERNEL))
+        return -ENOMEM;
+
+    ret = cpulist_parse(buf, mask);
+    if (!ret && !cpumask_intersects(mask, cpu_online_mask))
+        ret = -EINVAL;
+    if (ret)
+        goto out;
+
+    mutex_lock(&tx_lock);
+    ret = tx_worker_cpu < 0 ? set_cpus_allowed_ptr(tx_worker->task, mask) : 0;
+    if (!ret)
+        cpumask_copy(&tx_cpus, mask);
+    mutex_unlock(&tx_lock);
+
+out:
+    free_cpumask_var(mask);
+    return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(tx_cpus);
+
+// Hält das Gerät für eine Übertragung wach, ein dafür nötiger Resume wird in pm_resume_* erfasst
+static int monitoring_sys_pm_get(void)
+{
+    ktime_t start = ktime_get();
+    unsigned int us;
+    int ret;
+
+    ret = pm_runtime_resume_and_get(ms_dev);
+    if (ret)
+    {
+        pr_err_ratelimited("monitoring-sys: Runtime resume failed (%d)\n", ret);
+        return ret;
+    }
+
+    if (pm_resumed)
+    {
+        pm_resumed = false;
+        us = min_t(s64, ktime_us_delta(ktime_get(), start), U32_MAX);
+        pm_resume_count++;
+        pm_resume_last_us = us;
+        pm_resume_max_us = max(pm_resume_max_us, us);
+    }
+    return 0;
+}
+
+// Gibt das Gerät wieder frei, der Suspend folgt erst nach autosuspend_ms ohne weitere Übertragung
+static void monitoring_sys_pm_put(void)
+{
+    pm_runtime_mark_last_busy(ms_dev);
+    pm_runtime_put_autosuspend(ms_dev);
+}
+
+// Überträgt einen fertigen Frame (inklusive CRC) mit der gewählten Engine. Muss mit tx_lock aufgerufen werden.
+static int monitoring_sys_transmit(const uint8_t *buffer, size_t len)
+{
+    struct monitoring_sys_tx tx = {
+        .buffer = buffer,
+        .len = len,
+    };
+
+    return monitoring_sys_run(&tx);
+}
+
+// Hängt den CRC-32/JAMCRC little endian an die ersten len Bytes an und gibt die neue Länge zurück
+static size_t monitoring_sys_append_crc(uint8_t *buffer, size_t len)
+{
+    uint32_t crc = calculate_crc(buffer, len);
+
+    pr_info("monitoring-sys: crc=0x%08X\n", crc);
+    buffer[len] = crc & 0xFF;
+    buffer[len + 1] = (crc >> 8) & 0xFF;
+    buffer[len + 2] = (crc >> 16) & 0xFF;
+    buffer[len + 3] = (crc >> 24) & 0xFF;
+    return len + 4;
+}
+
+// Wiederholt alle offenen Frames ab dem ältesten (Go-Back-N). Muss mit tx_lock aufgerufen werden.
+static void monitoring_sys_window_retransmit(void)
+{
+    struct monitoring_sys_frame *frame;
+
+    for (unsigned int i = 0; i < win_count; i++) {
+        frame = &tx_window[(win_head + i) % MAX_WINDOW_SIZE];
+        monitoring_sys_transmit(frame->data, frame->len);
+        frame->sent = ktime_get();
+        frame->attempts++;
+    }
+}
+
+/*
+    Meldet einen endgültig fehlgeschlagenen Frame: Frames aus write() über queue_error an den nächsten write() bzw.
+    MONSYS_IOC_FLUSH, Frames der Kernel Produzenten nur über producer_errors. Transaktionen melden selbst.
+*/
+static void monitoring_sys_tx_failed(enum monitoring_sys_origin origin, int err)
+{
+    if (origin == MONSYS_FROM_WRITE)
+    {
+        cmpxchg(&queue_error, 0, err);
+    }
+    else if (origin == MONSYS_FROM_KERNEL)
+    {
+        spin_lock_bh(&queue_lock);
+        producer_errors++;
+        spin_unlock_bh(&queue_lock);
+    }
+}
+
+/*
+    Verarbeitet die seit dem letzten Aufruf eingegangenen ACK/NACK Pulse im Fenster-Modus.
+    Quittierte Frames werden aus dem Fenster entfernt. Nach einem NACK oder wenn der älteste Frame länger als
+    ack_timeout_us unquittiert ist, wird das Fenster wiederholt. Ein Frame, der ack_retries Wiederholungen
+    überschritten hat, wird verworfen, der Fehler wird je nach Herkunft des Frames beim nächsten write() als -EIO
+    gemeldet bzw. in producer_errors gezählt und der nächste Frame trägt das Resync Flag, damit der Empfänger nicht auf die verlorene Sequenznummer wartet.
+    Muss mit tx_lock aufgerufen werden.
+*/
+static void monitoring_sys_window_service(void)
+{
+    struct monitoring_sys_frame *frame;
+    unsigned int acks, nacks;
+    unsigned long flags;
+
+    spin_lock_irqsave(&ack_lock, flags);
+    acks = ack_count;
+    nacks = nack_count;
+    ack_count = 0;
+    nack_count = 0;
+    spin_unlock_irqrestore(&ack_lock, flags);
+
+    for (; acks && win_count; acks--) {
+        win_head = (win_head + 1) % MAX_WINDOW_SIZE;
+        win_count--;
+        monitoring_sys_rate_feedback(true);
+    }
+    if (!win_count)
+        return;
+
+    frame = &tx_window[win_head];
+    if (!nacks && ktime_us_delta(ktime_get(), frame->sent) < ack_timeout_us)
+        return;
+    monitoring_sys_rate_feedback(false);
+
+    while (win_count && tx_window[win_head].attempts > ack_retries) {
+        frame = &tx_window[win_head];
+        pr_err("monitoring-sys: Frame seq %u not acknowledged after %u attempts, dropping\n",
+               frame->data[frame->len - 5] & SEQ_MASK, frame->attempts);
+        win_head = (win_head + 1) % MAX_WINDOW_SIZE;
+        win_count--;
+        monitoring_sys_tx_failed(frame->origin, -EIO);
+        tx_resync = true;
+    }
+    if (!win_count)
+        return;
+
+    // Der älteste verbleibende Frame bekommt nach einem Verlust das Resync Flag und damit einen neuen CRC
+    frame = &tx_window[win_head];
+    if (tx_resync)
+    {
+        frame->data[frame->len - 5] |= SEQ_FLAG_RESYNC;
+        monitoring_sys_append_crc(frame->data, frame->len - 4);
+        tx_resync = false;
+    }
+
+    pr_warn("monitoring-sys: %s, retransmitting %u frame(s) from seq %u\n", nacks ? "NACK" : "ACK timeout",
+            win_count, frame->data[frame->len - 5] & SEQ_MASK);
+    monitoring_sys_window_retransmit();
+}
+
+/*
+    Wird nach ack_timeout_us aufgerufen, wenn noch unquittierte Frames im Fenster liegen, damit diese auch dann
+    wiederholt werden, wenn kein weiterer write() Aufruf folgt.
+*/
+static void monitoring_sys_window_work_fn(struct work_struct *work)
+{
+    if (monitoring_sys_pm_get())
+        return;
+    mutex_lock(&tx_lock);
+    monitoring_sys_window_service();
+    if (win_count)
+        mod_delayed_work(system_wq, &window_work, usecs_to_jiffies(ack_timeout_us) + 1);
+    mutex_unlock(&tx_lock);
+    monitoring_sys_pm_put();
+}
+
+/*
+    Sendet einen Frame im Fenster-Modus. Wartet, bis im Fenster ein Platz frei ist, hängt Sequenzbyte und CRC an,
+    überträgt den Frame und behält die Kopie bis zur Quittierung. Muss mit tx_lock aufgerufen werden.
+*/
+static int monitoring_sys_window_send(const uint8_t *buffer, size_t count, enum monitoring_sys_origin origin)
+{
+    struct monitoring_sys_frame *frame;
+    ktime_t remaining;
+    int ret;
+
+    monitoring_sys_window_service();
+    while (win_count >= window_size) {
+        remaining = ktime_sub(ktime_add_us(tx_window[win_head].sent, ack_timeout_us), ktime_get());
+        if (ktime_to_ns(remaining) > 0)
+        {
+            ret = wait_event_interruptible_hrtimeout(ack_wq, READ_ONCE(ack_count) || READ_ONCE(nack_count),
+                                                     remaining);
+            if (ret == -ERESTARTSYS)
+                return ret;
+        }
+        monitoring_sys_window_service();
+    }
+
+    frame = &tx_window[(win_head + win_count) % MAX_WINDOW_SIZE];
+    memcpy(frame->data, buffer, count);
+    frame->data[count] = tx_seq | (tx_resync ? SEQ_FLAG_RESYNC : 0);
+    frame->len = monitoring_sys_append_crc(frame->data, count + 1);
+    frame->origin = origin;
+    tx_seq = (tx_seq + 1) & SEQ_MASK;
+    tx_resync = false;
+
+    monitoring_sys_transmit(frame->data, frame->len);
+    frame->sent = ktime_get();
+    frame->attempts = 1;
+    win_count++;
+
+    mod_delayed_work(system_wq, &window_work, usecs_to_jiffies(ack_timeout_us) + 1);
+    return 0;
+}
+
+/*
+    Versieht die ersten count Bytes von buffer mit dem CRC und überträgt sie. buffer muss MAX_BUFFER_SIZE groß sein.
+    Ist eine ack-gpio Leitung vorhanden, wird ein nicht quittierter Frame bis zu ack_retries mal wiederholt,
+    bevor -EIO zurückgegeben wird. Im Fenster-Modus wird direkt nach dem Senden zurückgekehrt, ein endgültig
+    verlorener Frame wird abhängig von origin über monitoring_sys_tx_failed() gemeldet.
+    Muss mit tx_lock aufgerufen werden.
+*/
+static ssize_t monitoring_sys_send(uint8_t *buffer, size_t count, enum monitoring_sys_origin origin)
+{
+    ssize_t ret;
+    size_t total_len;
+    unsigned int attempt;
+
+    if (msa && window_size > 1)
+    {
+        ret = monitoring_sys_window_send(buffer, count, origin);
+        return ret ? ret : count + 5;
+    }
+
+    total_len = monitoring_sys_append_crc(buffer, count);
+
+    pr_info("monitoring-sys: total_len=%zu\n", total_len);
+
+    for (attempt = 0; ; attempt++) {
+        monitoring_sys_reset_ack();
+        ret = monitoring_sys_transmit(buffer, total_len);
+        if (ret)
+            return ret;
+        if (!msa)
+            break;
+
+        ret = monitoring_sys_wait_ack();
+        monitoring_sys_rate_feedback(!ret);
+        if (!ret)
+            break;
+
+        if (attempt >= ack_retries)
+        {
+            pr_err("monitoring-sys: Frame not acknowledged after %u attempts (%zd)\n", attempt + 1, ret);
+            return -EIO;
+        }
+        pr_warn("monitoring-sys: Frame not acknowledged (%zd), retransmitting [%u/%u]\n", ret, attempt + 1, ack_retries);
+    }
+
+    return total_len;
+}
+
+// Hängt buf an die Sendewarteschlange an bzw. gibt -EAGAIN zurück, wenn sie voll ist. Muss mit queue_lock aufgerufen werden.
+static int monitoring_sys_enqueue_locked(struct monitoring_sys_buf *buf, bool urgent)
+{
+    if (!urgent && queue_len >= queue_depth)
+        return -EAGAIN;
+    if (urgent)
+        list_add(&buf->node, &tx_queue);
+    else
+        list_add_tail(&buf->node, &tx_queue);
+    queue_len++;
+    return 0;
+}
+
+/*
+    Hängt einen Frame an die Sendewarteschlange an und weckt den Sende-Work, -EAGAIN wenn sie voll ist, -ENODEV
+    wenn sie (noch) keine Frames annimmt. Dringende Frames (Alarme) kommen an den Anfang der Warteschlange und
+    dürfen queue_depth überschreiten.
+*/
+static int __monitoring_sys_enqueue(struct monitoring_sys_buf *buf, bool urgent)
+{
+    int ret;
+
+    spin_lock_bh(&queue_lock);
+    ret = queue_open ? monitoring_sys_enqueue_locked(buf, urgent) : -ENODEV;
+    spin_unlock_bh(&queue_lock);
+
+    if (!ret)
+        queue_work(system_unbound_wq, &queue_work);
+    return ret;
+}
+
+static int monitoring_sys_enqueue(struct monitoring_sys_buf *buf)
+{
+    return __monitoring_sys_enqueue(buf, false);
+}
+
+/*
+    Exportierte Schnittstelle für andere Kernel Module (Sensor-Treiber, Watchdog, ...). Baut aus n Paaren einen
+    Frame [MONITORING_SYS_ADDR][id, Wert 16 Bit little endian]... und stellt ihn in die Sendewarteschlange.
+    Darf aus Prozess- und Softirq-Kontext aufgerufen werden und wartet nie: -ENODEV ohne gebundenes Gerät,
+    -ENOMEM ohne freien Frame-Puffer, -EAGAIN bei voller Warteschlange. Mit MONSYS_SUBMIT_URGENT kommt der Frame
+    an den Anfang der Warteschlange.
+*/
+int monsys_submit(const struct monsys_pair *pairs, unsigned int n, unsigned int flags)
+{
+    bool urgent = flags & MONSYS_SUBMIT_URGENT;
+    struct monitoring_sys_buf *buf;
+    int ret;
+
+    if (!n || n > MONSYS_MAX_PAIRS || (flags & ~MONSYS_SUBMIT_URGENT))
+        return -EINVAL;
+
+    spin_lock_bh(&queue_lock);
+    if (!queue_open)
+    {
+        ret = -ENODEV;
+        goto out_unlock;
+    }
+    buf = mempool_alloc(frame_pool, GFP_ATOMIC);
+    if (!buf)
+    {
+        ret = -ENOMEM;
+        goto out_unlock;
+    }
+
+    buf->data[0] = MONITORING_SYS_ADDR;
+    for (unsigned int i = 0; i < n; i++) {
+        buf->data[1 + 3 * i] = pairs[i].id;
+        buf->data[2 + 3 * i] = pairs[i].value & 0xFF;
+        buf->data[3 + 3 * i] = pairs[i].value >> 8;
+    }
+    buf->len = 1 + 3 * n;
+    buf->origin = MONSYS_FROM_KERNEL;
+
+    ret = monitoring_sys_enqueue_locked(buf, urgent);
+    if (ret)
+        mempool_free(buf, frame_pool);
+out_unlock:
+    spin_unlock_bh(&queue_lock);
+
+    if (!ret)
+        queue_work(system_unbound_wq, &queue_work);
+    return ret;
+}
+EXPORT_SYMBOL_GPL(monsys_submit);
+
+// Sende-Work: Arbeitet tx_queue ab, bis sie leer ist. Das Gerät wird einmal pro Durchlauf aufgeweckt.
+static void monitoring_sys_queue_work_fn(struct work_struct *work)
+{
+    struct monitoring_sys_buf *buf;
+    int pm_ret;
+    ssize_t ret;
+
+    pm_ret = monitoring_sys_pm_get();
+    for (;;) {
+        spin_lock_bh(&queue_lock);
+        buf = list_first_entry_or_null(&tx_queue, struct monitoring_sys_buf, node);
+        if (buf)
+            list_del(&buf->node);
+        spin_unlock_bh(&queue_lock);
+        if (!buf)
+            break;
+
+        ret = pm_ret;
+        if (!ret)
+        {
+            mutex_lock(&tx_lock);
+            ret = monitoring_sys_send(buf->data, buf->len, buf->origin);
+            mutex_unlock(&tx_lock);
+        }
+        if (ret < 0)
+            monitoring_sys_tx_failed(buf->origin, (int)ret);
+        mempool_free(buf, frame_pool);
+
+        spin_lock_bh(&queue_lock);
+        queue_len--;
+        spin_unlock_bh(&queue_lock);
+        wake_up(&queue_wq);
+    }
+    if (!pm_ret)
+        monitoring_sys_pm_put();
+}
+
+/*
+    Funktion die aufgerufen wird, wenn in die procfs Datei unter /proc/monitoring-system geschrieben wird. 
+    Die in die Datei geschriebenen Daten werden über den Parameter user_buffer in die Funktion übergeben und in die
+    Sendewarteschlange gestellt, der Sende-Work versieht sie mit einer 32-bit CRC Prüfsumme und überträgt sie.
+    Ist die Warteschlange voll, wird gewartet bzw. mit O_NONBLOCK -EAGAIN zurückgegeben.
+*/
+static ssize_t monitoring_sys_write(struct file *File, const char __user *user_buffer, size_t count, loff_t *offs) {
+    pr_info("monitoring-sys: In the monitoring_sys_write function. count: %zu\n", count);
+    struct monitoring_sys_buf *buf;
+    ssize_t len;
+    int ret;
+
+    if ((ret = xchg(&queue_error, 0)))
+        return ret;
+
+    if (count > MAX_BUFFER_SIZE - 4)
+    {
+        pr_err("monitoring-sys: count [%zu] > MAX_BUFFER_SIZE\n", count);
+        return -EINVAL;
+    }
+
+    buf = mempool_alloc(frame_pool, GFP_NOWAIT);
+    if (!buf)
+    {
+        pr_warn_ratelimited("monitoring-sys: No frame buffer available\n");
+        return -EAGAIN;
+    }
+
+    if ((ret = copy_from_user(buf->data, user_buffer, count)))
+    {
+        pr_err("monitoring-sys: Couldn't copy %d of %zu bytes from user buffer to kernel buffer\n", ret, count);
+        len = -EFAULT;
+        goto out_free;
+    }
+    buf->len = count;
+    buf->origin = MONSYS_FROM_WRITE;
+
+    while ((ret = monitoring_sys_enqueue(buf))) {
+        if (ret != -EAGAIN)
+        {
+            len = ret;
+            goto out_free;
+        }
+        if (File->f_flags & O_NONBLOCK)
+        {
+            len = -EAGAIN;
+            goto out_free;
+        }
+        if (wait_event_interruptible(queue_wq, READ_ONCE(queue_len) < queue_depth))
+        {
+            len = -ERESTARTSYS;
+            goto out_free;
+        }
+    }
+	return count;
+
+out_free:
+    mempool_free(buf, frame_pool);
+    return len;
+};
+
+// Wartet, bis alle Frames der Sendewarteschlange übertragen sind (MONSYS_IOC_FLUSH), und meldet einen Sendefehler
+static long monitoring_sys_flush(void)
+{
+    if (wait_event_interruptible(queue_wq, !READ_ONCE(queue_len)))
+        return -ERESTARTSYS;
+    return xchg(&queue_error, 0);
+}
+
+// Verwirft alle noch wartenden Frames und wartet auf das Ende des Sende-Works
+static void monitoring_sys_queue_exit(void)
+{
+    struct monitoring_sys_buf *buf, *tmp;
+    LIST_HEAD(pending);
+
+    spin_lock_bh(&queue_lock);
+    queue_open = false;
+    list_splice_init(&tx_queue, &pending);
+    spin_unlock_bh(&queue_lock);
+    cancel_work_sync(&queue_work);
+
+    list_for_each_entry_safe(buf, tmp, &pending, node)
+        mempool_free(buf, frame_pool);
+    queue_len = 0;
+    queue_error = 0;
+}
+
+/*
+    Interrupt Handler für die steigende Flanke auf rxc. Tastet rxd ab, setzt die Bits LSB first zu Bytes zusammen
+    und startet den Timer für die Erkennung des Frame Endes neu.
+*/
+static irqreturn_t monitoring_sys_rx_irq(int irq, void *dev_id)
+{
+    int bit = gpiod_get_value(rx_half_duplex ? msd : rxd) > 0;
+
+    spin_lock(&rx_lock);
+    if (rx_len < MAX_BUFFER_SIZE)
+    {
+        if (rx_bits == 0)
+            rx_buf[rx_len] = 0;
+        rx_buf[rx_len] |= bit << rx_bits;
+        if (++rx_bits == 8)
+        {
+            rx_bits = 0;
+            rx_len++;
+        }
+    }
+    else
+    {
+        rx_overflow = true;
+    }
+    spin_unlock(&rx_lock);
+
+    hrtimer_start(&rx_timer, us_to_ktime(rx_idle_us), HRTIMER_MODE_REL);
+    return IRQ_HANDLED;
+}
+
+/*
+    Wird rx_idle_us nach der letzten Taktflanke aufgerufen. Prüft Länge und CRC-32/JAMCRC des empfangenen Frames
+    und legt ihn ohne CRC in rx_fifo ab.
+*/
+static enum hrtimer_restart monitoring_sys_rx_timer_fn(struct hrtimer *timer)
+{
+    unsigned long flags;
+    uint32_t crc;
+    size_t len;
+
+    spin_lock_irqsave(&rx_lock, flags);
+    len = rx_len;
+    if (rx_overflow || rx_bits || len < 5)
+    {
+        pr_warn("monitoring-sys: Discarding malformed rx frame (%zu bytes, %u extra bits)\n", len, rx_bits);
+        rx_crc_errors++;
+        goto out;
+    }
+
+    crc = rx_buf[len - 4] | (rx_buf[len - 3] << 8) | (rx_buf[len - 2] << 16) | ((uint32_t)rx_buf[len - 1] << 24);
+    if (crc != calculate_crc(rx_buf, len - 4))
+    {
+        rx_crc_errors++;
+        goto out;
+    }
+
+    if (txn_addr == rx_buf[0])
+    {
+        memcpy(txn_buf, rx_buf, len - 4);
+        txn_len = len - 4;
+        txn_addr = -1;
+        rx_frames++;
+        complete(&txn_done);
+        goto out;
+    }
+
+    if (!kfifo_in(&rx_fifo, rx_buf, len - 4))
+    {
+        rx_dropped++;
+        goto out;
+    }
+    rx_frames++;
+    wake_up_interruptible(&rx_wq);
+
+out:
+    rx_len = 0;
+    rx_bits = 0;
+    rx_overflow = false;
+    spin_unlock_irqrestore(&rx_lock, flags);
+    return HRTIMER_NORESTART;
+}
+
+/*
+    Funktion die aufgerufen wird, wenn aus /proc/monitoring-system gelesen wird.
+    Liefert pro Aufruf genau einen empfangenen Frame (Adresse + Daten, ohne CRC) und blockiert, bis einer vorliegt.
+    Ist der Puffer des Aufrufers zu klein, bleibt der Frame in der FIFO und der Aufruf schlägt mit -EMSGSIZE fehl.
+*/
+static ssize_t monitoring_sys_read(struct file *File, char __user *user_buffer, size_t count, loff_t *offs)
+{
+    unsigned int copied;
+    int ret;
+
+    if (!rxc)
+        return 0;
+
+    if (mutex_lock_interruptible(&rx_read_lock))
+        return -ERESTARTSYS;
+
+    while (kfifo_is_empty(&rx_fifo)) {
+        mutex_unlock(&rx_read_lock);
+        if (READ_ONCE(rx_gone))
+            return -ENODEV;
+        if (File->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        if (wait_event_interruptible(rx_wq, !kfifo_is_empty(&rx_fifo) || READ_ONCE(rx_gone)))
+            return -ERESTARTSYS;
+        if (mutex_lock_interruptible(&rx_read_lock))
+            return -ERESTARTSYS;
+    }
+
+    if (kfifo_peek_len(&rx_fifo) > count)
+    {
+        mutex_unlock(&rx_read_lock);
+        return -EMSGSIZE;
+    }
+
+    ret = kfifo_to_user(&rx_fifo, user_buffer, count, &copied);
+    mutex_unlock(&rx_read_lock);
+    return ret ? ret : copied;
+}
+
+// poll() auf /proc/monitoring-system, lesbar sobald ein empfangener Frame vorliegt
+static __poll_t monitoring_sys_poll(struct file *File, struct poll_table_struct *wait)
+{
+    __poll_t mask = 0;
+
+    poll_wait(File, &rx_wq, wait);
+    poll_wait(File, &queue_wq, wait);
+    if (!kfifo_is_empty(&rx_fifo))
+        mask |= EPOLLIN | EPOLLRDNORM;
+    if (READ_ONCE(queue_len) < queue_depth)
+        mask |= EPOLLOUT | EPOLLWRNORM;
+    return mask;
+}
+
+/*
+    Führt eine Anfrage/Antwort Transaktion aus (MONSYS_IOC_TRANSACT): sendet [addr][req], schaltet im Halbduplex
+    Betrieb msd auf Eingang und wartet bis timeout_ms auf einen Antwort-Frame mit derselben Adresse.
+    Die Round-Trip Latenz wird zurückgegeben und im Histogramm txn_latency erfasst. timeout_ms wird auf
+    txn_timeout_max_ms begrenzt.
+*/
+static long monitoring_sys_transact(struct monsys_transaction __user *argp)
+{
+    struct monsys_transaction txn;
+    struct monitoring_sys_buf *buf;
+    uint8_t *buffer;
+    unsigned long flags;
+    bool tx_locked = true;
+    ktime_t start;
+    s64 latency;
+    long left;
+    long ret;
+
+    if (!rxc)
+        return -EOPNOTSUPP;
+    if (copy_from_user(&txn, argp, sizeof(txn)))
+        return -EFAULT;
+    if (txn.req_len > MAX_BUFFER_SIZE - 5)
+        return -EINVAL;
+
+    buf = mempool_alloc(frame_pool, GFP_NOWAIT);
+    if (!buf)
+        return -EAGAIN;
+    buffer = buf->data;
+
+    buffer[0] = txn.addr;
+    if (copy_from_user(buffer + 1, u64_to_user_ptr(txn.req), txn.req_len))
+    {
+        ret = -EFAULT;
+        goto out_free;
+    }
+
+    ret = monitoring_sys_pm_get();
+    if (ret)
+        goto out_free;
+
+    if (mutex_lock_interruptible(&txn_lock))
+    {
+        ret = -ERESTARTSYS;
+        goto out_put;
+    }
+    if (mutex_lock_interruptible(&tx_lock))
+    {
+        ret = -ERESTARTSYS;
+        goto out_txn_unlock;
+    }
+
+    // Erst scharf schalten, dann senden, damit auch eine sehr schnelle Antwort nicht in rx_fifo landet
+    spin_lock_irqsave(&rx_lock, flags);
+    reinit_completion(&txn_done);
+    txn_addr = txn.addr;
+    spin_unlock_irqrestore(&rx_lock, flags);
+
+    start = ktime_get();
+    ret = monitoring_sys_send(buffer, txn.req_len + 1, MONSYS_FROM_TXN);
+    if (ret < 0)
+        goto out_cancel;
+
+    if (rx_half_duplex)
+    {
+        gpiod_direction_input(msd);
+        enable_irq(rx_irq);
+    }
+    else
+    {
+        mutex_unlock(&tx_lock);
+        tx_locked = false;
+    }
+    left = wait_for_completion_interruptible_timeout(&txn_done,
+                                                     msecs_to_jiffies(min(txn.timeout_ms, txn_timeout_max_ms)));
+    if (rx_half_duplex)
+    {
+        disable_irq(rx_irq);
+        gpiod_direction_output(msd, 0);
+    }
+
+    if (left <= 0)
+    {
+        ret = left ? left : -ETIMEDOUT;
+        if (!left)
+            txn_timeouts++;
+        goto out_cancel;
+    }
+
+    latency = ktime_us_delta(ktime_get(), start);
+    txn_hist[min_t(unsigned int, ilog2((u64)latency | 1), TXN_HIST_BUCKETS - 1)]++;
+
+    if (txn_len > txn.resp_len)
+    {
+        ret = -EMSGSIZE;
+        goto out_unlock;
+    }
+    if (copy_to_user(u64_to_user_ptr(txn.resp), txn_buf, txn_len))
+    {
+        ret = -EFAULT;
+        goto out_unlock;
+    }
+    txn.resp_len = txn_len;
+    txn.latency_us = min_t(s64, latency, U32_MAX);
+    ret = copy_to_user(argp, &txn, sizeof(txn)) ? -EFAULT : 0;
+    goto out_unlock;
+
+out_cancel:
+    spin_lock_irqsave(&rx_lock, flags);
+    txn_addr = -1;
+    spin_unlock_irqrestore(&rx_lock, flags);
+out_unlock:
+    if (tx_locked)
+        mutex_unlock(&tx_lock);
+out_txn_unlock:
+    mutex_unlock(&txn_lock);
+out_put:
+    monitoring_sys_pm_put();
+out_free:
+    mempool_free(buf, frame_pool);
+    return ret;
+}
+
+/*
+    Parallele Übertragung (MONSYS_IOC_SEND_PARALLEL). Jeder Frame erhält seinen eigenen CRC. Da sich alle Empfänger
+    msc teilen und das Frame Ende an der Taktpause erkennen, werden nur gleich lange Frames gemeinsam getaktet,
+    Gruppen unterschiedlicher Länge folgen nacheinander. Quittierung und Fenster-Modus gelten hier nicht.
+*/
+static long monitoring_sys_send_parallel(struct monsys_parallel __user *argp)
+{
+    struct monsys_parallel par;
+    struct monitoring_sys_tx tx = {};
+    unsigned long pending = 0;
+    unsigned long group;
+    unsigned int lane, first;
+    long ret = 0;
+
+    if (!msd_lanes || msd_lanes->ndescs < 2 || target_mode || manchester_mode)
+        return -EOPNOTSUPP;
+    if (copy_from_user(&par, argp, sizeof(par)))
+        return -EFAULT;
+
+    if (mutex_lock_interruptible(&tx_lock))
+        return -ERESTARTSYS;
+
+    for (lane = 0; lane < msd_lanes->ndescs; lane++) {
+        if (!par.len[lane])
+            continue;
+        if (par.len[lane] > MAX_BUFFER_SIZE - 4)
+        {
+            ret = -EINVAL;
+            goto out;
+        }
+        if (copy_from_user(lane_buf[lane], u64_to_user_ptr(par.frames[lane]), par.len[lane]))
+        {
+            ret = -EFAULT;
+            goto out;
+        }
+        lane_len[lane] = monitoring_sys_append_crc(lane_buf[lane], par.len[lane]);
+        __set_bit(lane, &pending);
+    }
+
+    ret = monitoring_sys_pm_get();
+    if (ret)
+        goto out;
+    while (pending) {
+        first = __ffs(pending);
+        group = 0;
+        for_each_set_bit(lane, &pending, msd_lanes->ndescs)
+            if (lane_len[lane] == lane_len[first])
+                __set_bit(lane, &group);
+        pending &= ~group;
+
+        tx.lanes = group;
+        tx.len = lane_len[first];
+        ret = monitoring_sys_run(&tx);
+        if (ret)
+            break;
+    }
+    monitoring_sys_pm_put();
+
+out:
+    mutex_unlock(&tx_lock);
+    return ret;
+}
+
+// ioctl() auf /proc/monitoring-system
+static long monitoring_sys_ioctl(struct file *File, unsigned int cmd, unsigned long arg)
+{
+    switch (cmd) {
+    case MONSYS_IOC_TRANSACT:
+        return monitoring_sys_transact((struct monsys_transaction __user *)arg);
+    case MONSYS_IOC_SEND_PARALLEL:
+        return monitoring_sys_send_parallel((struct monsys_parallel __user *)arg);
+    case MONSYS_IOC_FLUSH:
+        return monitoring_sys_flush();
+    default:
+        return -ENOTTY;
+    }
+}
+
+static ssize_t pm_resume_latency_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    int len = 0;
+
+    len += sysfs_emit_at(buf, len, "resumes: %lu\n", pm_resume_count);
+    len += sysfs_emit_at(buf, len, "last_us: %u\n", pm_resume_last_us);
+    len += sysfs_emit_at(buf, len, "max_us: %u\n", pm_resume_max_us);
+    return len;
+}
+static DEVICE_ATTR_RO(pm_resume_latency);
+
+static ssize_t txn_latency_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    int len = 0;
+
+    for (int i = 0; i < TXN_HIST_BUCKETS - 1; i++)
+        len += sysfs_emit_at(buf, len, "<%u us: %lu\n", 2U << i, txn_hist[i]);
+    len += sysfs_emit_at(buf, len, ">=%u us: %lu\n", 1U << (TXN_HIST_BUCKETS - 1), txn_hist[TXN_HIST_BUCKETS - 1]);
+    return len;
+}
+static DEVICE_ATTR_RO(txn_latency);
+
+static ssize_t txn_timeouts_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%lu\n", txn_timeouts);
+}
+static DEVICE_ATTR_RO(txn_timeouts);
+
+static ssize_t producer_errors_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%lu\n", producer_errors);
+}
+static DEVICE_ATTR_RO(producer_errors);
+
+static ssize_t rx_frames_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%lu\n", rx_frames);
+}
+static DEVICE_ATTR_RO(rx_frames);
+
+static ssize_t rx_crc_errors_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%lu\n", rx_crc_errors);
+}
+static DEVICE_ATTR_RO(rx_crc_errors);
+
+static ssize_t rx_dropped_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%lu\n", rx_dropped);
+}
+static DEVICE_ATTR_RO(rx_dropped);
+
+/*
+    Initialisiert den optionalen Empfangspfad. Ohne rxc-gpio und rxd-gpio bleibt der Treiber reiner Sender.
+*/
+static int monitoring_sys_rx_init(struct device *dev)
+{
+    int ret;
+
+    INIT_KFIFO(rx_fifo);
+    hrtimer_init(&rx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    rx_timer.function = monitoring_sys_rx_timer_fn;
+
+    rxc = gpiod_get_optional(dev, "rxc", GPIOD_IN);
+    if (IS_ERR(rxc))
+    {
+        pr_err("monitoring-sys: Couldn't get rxc GPIO\n");
+        ret = PTR_ERR(rxc);
+        rxc = NULL;
+        return ret;
+    }
+    rxd = gpiod_get_optional(dev, "rxd", GPIOD_IN);
+    if (IS_ERR(rxd))
+    {
+        pr_err("monitoring-sys: Couldn't get rxd GPIO\n");
+        ret = PTR_ERR(rxd);
+        goto err_put_rxc;
+    }
+    if (!rxc && !rxd)
+        return 0;
+    rx_half_duplex = rxc && !rxd;
+    if (!rxc || (rx_half_duplex && !msd) || gpiod_cansleep(rx_half_duplex ? msd : rxd))
+    {
+        pr_err("monitoring-sys: Receive path needs rxc and a data line on a non-sleeping controller\n");
+        ret = -EINVAL;
+        goto err_put_rxd;
+    }
+
+    rx_irq = gpiod_to_irq(rxc);
+    if (rx_irq < 0)
+    {
+        pr_err("monitoring-sys: rxc GPIO has no interrupt\n");
+        ret = rx_irq;
+        goto err_put_rxd;
+    }
+    // Im Halbduplex Betrieb ist msd ein Ausgang, der Interrupt wird nur während einer Transaktion freigegeben
+    ret = request_irq(rx_irq, monitoring_sys_rx_irq, IRQF_TRIGGER_RISING | (rx_half_duplex ? IRQF_NO_AUTOEN : 0),
+                      "monitoring-sys-rx", NULL);
+    if (ret)
+    {
+        pr_err("monitoring-sys: Couldn't request rx interrupt\n");
+        goto err_put_rxd;
+    }
+    pr_info("monitoring-sys: Receive path enabled (%s)\n", rx_half_duplex ? "half duplex on msd" : "rxd");
+    return 0;
+
+err_put_rxd:
+    gpiod_put(rxd);
+err_put_rxc:
+    gpiod_put(rxc);
+    rxc = NULL;
+    rxd = NULL;
+    rx_irq = -1;
+    rx_half_duplex = false;
+    return ret;
+}
+
+// Gibt den Empfangspfad wieder frei
+static void monitoring_sys_rx_exit(void)
+{
+    if (rxc)
+        free_irq(rx_irq, NULL);
+    hrtimer_cancel(&rx_timer);
+    gpiod_put(rxd);
+    gpiod_put(rxc);
+    rxc = NULL;
+    rxd = NULL;
+    rx_irq = -1;
+    rx_half_duplex = false;
+}
+
+/*
+    Initialisiert den Target Modus: msc wurde als Eingang angefordert, die fallende Flanke wird per Interrupt
+    überwacht, der nur während einer Übertragung freigegeben ist.
+*/
+static int monitoring_sys_target_init(void)
+{
+    int ret;
+
+    if (gpiod_cansleep(msd) || gpiod_cansleep(msc))
+    {
+        pr_err("monitoring-sys: Target mode needs msd and msc on a non-sleeping controller\n");
+        return -EINVAL;
+    }
+    target_irq = gpiod_to_irq(msc);
+    if (target_irq < 0)
+    {
+        pr_err("monitoring-sys: msc GPIO has no interrupt\n");
+        ret = target_irq;
+        target_irq = -1;
+        return ret;
+    }
+    // Im DDR Modus tastet die Gegenstelle auf beiden Flanken ab, das nächste Bit wird dann nach jeder Flanke angelegt
+    ret = request_irq(target_irq, monitoring_sys_target_irq,
+                      (ddr_mode ? IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING : IRQF_TRIGGER_FALLING) | IRQF_NO_AUTOEN,
+                      "monitoring-sys-target", NULL);
+    if (ret)
+    {
+        pr_err("monitoring-sys: Couldn't request target interrupt\n");
+        target_irq = -1;
+        return ret;
+    }
+    pr_info("monitoring-sys: Target mode enabled, peer drives msc\n");
+    return 0;
+}
+
+static void monitoring_sys_target_exit(void)
+{
+    if (target_irq >= 0)
+        free_irq(target_irq, NULL);
+    target_irq = -1;
+}
+
+static struct proc_ops fops = {
+    .proc_write = monitoring_sys_write,
+    .proc_read = monitoring_sys_read,
+    .proc_poll = monitoring_sys_poll,
+    .proc_ioctl = monitoring_sys_ioctl,
+    .proc_compat_ioctl = compat_ptr_ioctl,
+};
+
+/*
+    In-Kernel Sampler. Unter /sys/kernel/config/monitoring-system legt mkdir einen Kanal an, dessen Attribute
+    id (Wert ID im Frame), source (hwmon Attribut unter /sys/class/hwmon, z.B. hwmon0/temp1_input), divisor
+    (Teiler für den gelesenen Wert) und period_ms (eigene Periode, 0 = period_ms des Wurzelverzeichnisses) festlegen.
+    Ohne source kommt der Wert aus der Wertetabelle, die über das Attribut value oder monsys_set_value() gefüllt wird.
+    sample_work läuft zum nächsten Fälligkeitszeitpunkt aller Kanäle, liest nur die fälligen Kanäle und stellt einen
+    Frame [MONITORING_SYS_ADDR][id, Wert 16 Bit little endian]... in die Sendewarteschlange, ohne Umweg über sysmond.
+    Ist die Warteschlange voll, wird die Messung verworfen statt zu warten.
+*/
+#define SAMPLER_SOURCE_PREFIX "/sys/class/hwmon/"
+#define SAMPLER_MAX_CHANNELS 256
+
+struct monitoring_sys_channel {
+    struct config_item item;
+    struct list_head node;
+    uint8_t id;
+    long divisor;
+    unsigned int period_ms;
+    unsigned long next_due; // jiffies
+    char source[128];
+    struct file *file;
+};
+
+static LIST_HEAD(sampler_channels);
+static unsigned int sampler_count;
+static DEFINE_MUTEX(sampler_lock); // Schützt Kanäle, period_ms und sampler_bound
+static unsigned int sampler_period_ms;
+static bool sampler_bound;         // Gerät gebunden, die Sendewarteschlange existiert
+static unsigned long sampler_frames;
+static unsigned long sampler_dropped;
+static unsigned long sampler_errors;
+static void monitoring_sys_sample_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(sample_work, monitoring_sys_sample_work_fn);
+
+// Wertetabelle für Kanäle ohne source, ein Eintrag pro Wert ID
+static u16 sampler_values[SAMPLER_MAX_CHANNELS];
+static DECLARE_BITMAP(sampler_valid, SAMPLER_MAX_CHANNELS);
+
+/*
+    Exportierte Schnittstelle: Setzt den Wert einer ID in der Wertetabelle. Er wird mit der Periode des Kanals mit
+    dieser ID gesendet. Aus jedem Kontext aufrufbar.
+*/
+void monsys_set_value(u8 id, u16 value)
+{
+    WRITE_ONCE(sampler_values[id], value);
+    set_bit(id, sampler_valid);
+}
+EXPORT_SYMBOL_GPL(monsys_set_value);
+
+/*
+    Liest den aktuellen Wert eines Kanals, die hwmon Datei wird dafür jedes Mal ab Offset 0 gelesen. hwmon Werte
+    sind vorzeichenbehaftet (Temperaturen unter 0 °C) und werden wie bei IIO und Thermal als 16 Bit
+    Zweierkomplement gesendet.
+*/
+static int monitoring_sys_sample_channel(struct monitoring_sys_channel *ch, uint16_t *value)
+{
+    char text[24];
+    loff_t pos = 0;
+    ssize_t len;
+    long val;
+    int ret;
+
+    if (!ch->file)
+    {
+        if (!test_bit(ch->id, sampler_valid))
+            return -ENODATA;
+        *value = READ_ONCE(sampler_values[ch->id]);
+        return 0;
+    }
+    len = kernel_read(ch->file, text, sizeof(text) - 1, &pos);
+    if (len < 0)
+        return len;
+    text[len] = '\0';
+    ret = kstrtol(strim(text), 10, &val);
+    if (ret)
+        return ret;
+
+    *value = (u16)clamp_t(long, val / ch->divisor, S16_MIN, S16_MAX);
+    return 0;
+}
+
+// Periode eines Kanals in ms, 0 wenn er nicht abgetastet wird
+static unsigned int monitoring_sys_channel_period(struct monitoring_sys_channel *ch)
+{
+    return ch->period_ms ? ch->period_ms : sampler_period_ms;
+}
+
+/*
+    Liest alle fälligen Kanäle, stellt den Frame in die Sendewarteschlange und plant sample_work zum nächsten
+    Fälligkeitszeitpunkt. Ist kein Kanal aktiv, wird nichts geplant. Ein Kanal, der mehr als eine Periode im
+    Verzug ist, wird ab jetzt neu getaktet statt die verpassten Perioden nachzuholen.
+*/
+static void monitoring_sys_sample_work_fn(struct work_struct *work)
+{
+    struct monitoring_sys_channel *ch;
+    struct monitoring_sys_buf *buf = NULL;
+    unsigned long now = jiffies, next = 0;
+    bool armed = false, nobuf = false, due;
+    unsigned int period;
+    uint16_t value;
+    size_t len = 1;
+
+    mutex_lock(&sampler_lock);
+    if (!sampler_bound)
+        goto out;
+
+    list_for_each_entry(ch, &sampler_channels, node) {
+        period = monitoring_sys_channel_period(ch);
+        if (!period)
+            continue;
+
+        due = time_after_eq(now, ch->next_due);
+        if (due)
+        {
+            ch->next_due += msecs_to_jiffies(period);
+            if (time_after_eq(now, ch->next_due))
+                ch->next_due = now + msecs_to_jiffies(period);
+        }
+
+        // Vor jedem continue einplanen, sonst tastet ein fehlschlagender Kanal nie wieder ab
+        if (!armed || time_before(ch->next_due, next))
+        {
+            next = ch->next_due;
+            armed = true;
+        }
+        if (!due)
+            continue;
+
+        if (!buf && !nobuf)
+        {
+            buf = mempool_alloc(frame_pool, GFP_NOWAIT);
+            nobuf = !buf;
+        }
+        if (!buf)
+            continue;
+        if (monitoring_sys_sample_channel(ch, &value))
+        {
+            sampler_errors++;
+            continue;
+        }
+        buf->data[len++] = ch->id;
+        buf->data[len++] = value & 0xFF;
+        buf->data[len++] = value >> 8;
+    }
+
+    if (nobuf)
+        sampler_dropped++;
+    if (buf)
+    {
+        buf->data[0] = MONITORING_SYS_ADDR;
+        buf->len = len;
+        buf->origin = MONSYS_FROM_KERNEL;
+        if (len == 1 || monitoring_sys_enqueue(buf))
+        {
+            if (len > 1)
+                sampler_dropped++;
+            mempool_free(buf, frame_pool);
+        }
+        else
+            sampler_frames++;
+    }
+
+    if (armed)
+        queue_delayed_work(system_power_efficient_wq, &sample_work, next - now);
+out:
+    mutex_unlock(&sampler_lock);
+}
+
+// Plant die Kanäle nach einer Änderung neu. Muss mit sampler_lock aufgerufen werden.
+static void monitoring_sys_sampler_kick(void)
+{
+    if (sampler_bound)
+        mod_delayed_work(system_power_efficient_wq, &sample_work, 0);
+}
+
+static inline struct monitoring_sys_channel *to_monitoring_sys_channel(struct config_item *item)
+{
+    return container_of(item, struct monitoring_sys_channel, item);
+}
+
+static ssize_t monitoring_sys_channel_id_show(struct config_item *item, char *page)
+{
+    return sprintf(page, "%u\n", to_monitoring_sys_channel(item)->id);
+}
+
+static ssize_t monitoring_sys_channel_id_store(struct config_item *item, const char *page, size_t count)
+{
+    u8 id;
+    int ret;
+
+    ret = kstrtou8(page, 0, &id);
+    if (ret)
+        return ret;
+    mutex_lock(&sampler_lock);
+    to_monitoring_sys_channel(item)->id = id;
+    mutex_unlock(&sampler_lock);
+    return count;
+}
+
+static ssize_t monitoring_sys_channel_source_show(struct config_item *item, char *page)
+{
+    return sprintf(page, "%s\n", to_monitoring_sys_channel(item)->source);
+}
+
+// Öffnet das hwmon Attribut einmalig, gelesen wird später nur noch über die geöffnete Datei
+static ssize_t monitoring_sys_channel_source_store(struct config_item *item, const char *page, size_t count)
+{
+    struct monitoring_sys_channel *ch = to_monitoring_sys_channel(item);
+    char path[sizeof(ch->source)];
+    struct file *file, *old;
+
+    if (strscpy(path, page, sizeof(path)) < 0)
+        return -ENAMETOOLONG;
+    strim(path);
+    if (strncmp(path, SAMPLER_SOURCE_PREFIX, strlen(SAMPLER_SOURCE_PREFIX)) || strstr(path, ".."))
+    {
+        pr_err("monitoring-sys: Sampler source must be below " SAMPLER_SOURCE_PREFIX "\n");
+        return -EINVAL;
+    }
+
+    file = filp_open(path, O_RDONLY, 0);
+    if (IS_ERR(file))
+        return PTR_ERR(file);
+
+    mutex_lock(&sampler_lock);
+    old = ch->file;
+    ch->file = file;
+    strscpy(ch->source, path, sizeof(ch->source));
+    mutex_unlock(&sampler_lock);
+
+    if (old)
+        fput(old);
+    return count;
+}
+
+static ssize_t monitoring_sys_channel_period_ms_show(struct config_item *item, char *page)
+{
+    return sprintf(page, "%u\n", to_monitoring_sys_channel(item)->period_ms);
+}
+
+static ssize_t monitoring_sys_channel_period_ms_store(struct config_item *item, const char *page, size_t count)
+{
+    struct monitoring_sys_channel *ch = to_monitoring_sys_channel(item);
+    unsigned int period;
+    int ret;
+
+    ret = kstrtouint(page, 0, &period);
+    if (ret)
+        return ret;
+    mutex_lock(&sampler_lock);
+    ch->period_ms = period;
+    ch->next_due = jiffies;
+    monitoring_sys_sampler_kick();
+    mutex_unlock(&sampler_lock);
+    return count;
+}
+
+static ssize_t monitoring_sys_channel_value_show(struct config_item *item, char *page)
+{
+    uint8_t id = to_monitoring_sys_channel(item)->id;
+
+    if (!test_bit(id, sampler_valid))
+        return sprintf(page, "none\n");
+    return sprintf(page, "%u\n", READ_ONCE(sampler_values[id]));
+}
+
+static ssize_t monitoring_sys_channel_value_store(struct config_item *item, const char *page, size_t count)
+{
+    u16 value;
+    int ret;
+
+    ret = kstrtou16(page, 0, &value);
+    if (ret)
+        return ret;
+    monsys_set_value(to_monitoring_sys_channel(item)->id, value);
+    return count;
+}
+
+static ssize_t monitoring_sys_channel_divisor_show(struct config_item *item, char *page)
+{
+    return sprintf(page, "%ld\n", to_monitoring_sys_channel(item)->divisor);
+}
+
+static ssize_t monitoring_sys_channel_divisor_store(struct config_item *item, const char *page, size_t count)
+{
+    long divisor;
+    int ret;
+
+    ret = kstrtol(page, 0, &divisor);
+    if (ret)
+        return ret;
+    if (divisor <= 0)
+        return -EINVAL;
+    mutex_lock(&sampler_lock);
+    to_monitoring_sys_channel(item)->divisor = divisor;
+    mutex_unlock(&sampler_lock);
+    return count;
+}
+
+CONFIGFS_ATTR(monitoring_sys_channel_, id);
+CONFIGFS_ATTR(monitoring_sys_channel_, source);
+CONFIGFS_ATTR(monitoring_sys_channel_, divisor);
+CONFIGFS_ATTR(monitoring_sys_channel_, period_ms);
+CONFIGFS_ATTR(monitoring_sys_channel_, value);
+
+static struct configfs_attribute *monitoring_sys_channel_attrs[] = {
+    &monitoring_sys_channel_attr_id,
+    &monitoring_sys_channel_attr_source,
+    &monitoring_sys_channel_attr_divisor,
+    &monitoring_sys_channel_attr_period_ms,
+    &monitoring_sys_channel_attr_value,
+    NULL,
+};
+
+static void monitoring_sys_channel_release(struct config_item *item)
+{
+    struct monitoring_sys_channel *ch = to_monitoring_sys_channel(item);
+
+    if (ch->file)
+        fput(ch->file);
+    kfree(ch);
+}
+
+static struct configfs_item_operations monitoring_sys_channel_item_ops = {
+    .release = monitoring_sys_channel_release,
+};
+
+static const struct config_item_type monitoring_sys_channel_type = {
+    .ct_item_ops = &monitoring_sys_channel_item_ops,
+    .ct_attrs = monitoring_sys_channel_attrs,
+    .ct_owner = THIS_MODULE,
+};
+
+// mkdir unter /sys/kernel/config/monitoring-system legt einen neuen Kanal an
+static struct config_item *monitoring_sys_make_channel(struct config_group *group, const char *name)
+{
+    struct monitoring_sys_channel *ch;
+
+    ch = kzalloc(sizeof(*ch), GFP_KERNEL);
+    if (!ch)
+        return ERR_PTR(-ENOMEM);
+    ch->divisor = 1;
+    ch->next_due = jiffies;
+    config_item_init_type_name(&ch->item, name, &monitoring_sys_channel_type);
+
+    mutex_lock(&sampler_lock);
+    if (sampler_count >= SAMPLER_MAX_CHANNELS)
+    {
+        mutex_unlock(&sampler_lock);
+        kfree(ch);
+        return ERR_PTR(-ENOSPC);
+    }
+    list_add_tail(&ch->node, &sampler_channels);
+    sampler_count++;
+    monitoring_sys_sampler_kick();
+    mutex_unlock(&sampler_lock);
+    return &ch->item;
+}
+
+static void monitoring_sys_drop_channel(struct config_group *group, struct config_item *item)
+{
+    struct monitoring_sys_channel *ch = to_monitoring_sys_channel(item);
+
+    mutex_lock(&sampler_lock);
+    list_del(&ch->node);
+    sampler_count--;
+    mutex_unlock(&sampler_lock);
+    config_item_put(item);
+}
+
+static ssize_t monitoring_sys_sampler_period_ms_show(struct config_item *item, char *page)
+{
+    return sprintf(page, "%u\n", sampler_period_ms);
+}
+
+static ssize_t monitoring_sys_sampler_period_ms_store(struct config_item *item, const char *page, size_t count)
+{
+    struct monitoring_sys_channel *ch;
+    unsigned int period;
+    int ret;
+
+    ret = kstrtouint(page, 0, &period);
+    if (ret)
+        return ret;
+    mutex_lock(&sampler_lock);
+    sampler_period_ms = period;
+    list_for_each_entry(ch, &sampler_channels, node)
+        ch->next_due = jiffies;
+    monitoring_sys_sampler_kick();
+    mutex_unlock(&sampler_lock);
+    return count;
+}
+
+static ssize_t monitoring_sys_sampler_stats_show(struct config_item *item, char *page)
+{
+    return sprintf(page, "frames: %lu\ndropped: %lu\nerrors: %lu\n", sampler_frames, sampler_dropped,
+                   sampler_errors);
+}
+
+CONFIGFS_ATTR(monitoring_sys_sampler_, period_ms);
+CONFIGFS_ATTR_RO(monitoring_sys_sampler_, stats);
+
+static struct configfs_attribute *monitoring_sys_sampler_attrs[] = {
+    &monitoring_sys_sampler_attr_period_ms,
+    &monitoring_sys_sampler_attr_stats,
+    NULL,
+};
+
+static struct configfs_group_operations monitoring_sys_sampler_group_ops = {
+    .make_item = monitoring_sys_make_channel,
+    .drop_item = monitoring_sys_drop_channel,
+};
+
+static const struct config_item_type monitoring_sys_sampler_type = {
+    .ct_group_ops = &monitoring_sys_sampler_group_ops,
+    .ct_attrs = monitoring_sys_sampler_attrs,
+    .ct_owner = THIS_MODULE,
+};
+
+static struct configfs_subsystem monitoring_sys_subsys = {
+    .su_group = {
+        .cg_item = {
+            .ci_namebuf = "monitoring-system",
+            .ci_type = &monitoring_sys_sampler_type,
+        },
+    },
+};
+
+// Gibt den Sampler frei, sobald die Sendewarteschlange existiert (bind) bzw. hält ihn vor dem Abbau an (unbind)
+static void monitoring_sys_sampler_bind(bool bound)
+{
+    mutex_lock(&sampler_lock);
+    sampler_bound = bound;
+    monitoring_sys_sampler_kick();
+    mutex_unlock(&sampler_lock);
+    if (!bound)
+        cancel_delayed_work_sync(&sample_work);
+}
+
+/*
+    IIO Consumer. Sind im Device Tree io-channels (alle vom selben ADC) und dazu iio-ids mit einer Wert ID pro Kanal
+    gesetzt, hängt sich der Treiber als Callback-Puffer an den Triggered Buffer des ADC. Jeder Scan wird direkt im
+    Callback als [id, Wert 16 Bit little endian] pro Kanal an iio_frame angehängt. Der Frame wird nach iio_batch_ms
+    ab dem ersten Sample oder sobald er voll ist von iio_work in die Sendewarteschlange gestellt und durch einen
+    neuen Puffer aus dem Pool ersetzt. Ohne Samples ist iio_work nicht geplant.
+*/
+struct monitoring_sys_iio_map {
+    const struct iio_chan_spec *spec;
+    unsigned int offset; // Position des Kanals im Scan
+    uint8_t id;
+};
+
+static struct iio_cb_buffer *iio_cb;
+static bool iio_running;
+static struct monitoring_sys_iio_map iio_map[IIO_MAX_CHANNELS];
+static unsigned int iio_nch;
+static DEFINE_SPINLOCK(iio_lock);
+static struct monitoring_sys_buf *iio_frame;
+static unsigned long iio_samples;
+static unsigned long iio_dropped;
+static void monitoring_sys_iio_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(iio_work, monitoring_sys_iio_work_fn);
+
+// Liest einen Kanal aus dem Scan und bringt ihn auf 16 Bit, vorzeichenbehaftete Werte als Zweierkomplement
+static uint16_t monitoring_sys_iio_value(const struct monitoring_sys_iio_map *map, const void *scan)
+{
+    const struct iio_scan_type *type = &map->spec->scan_type;
+    const void *p = scan + map->offset;
+    u32 raw;
+
+    switch (type->storagebits) {
+    case 8:
+        raw = *(const u8 *)p;
+        break;
+    case 16:
+        raw = type->endianness == IIO_BE ? get_unaligned_be16(p) :
+              type->endianness == IIO_LE ? get_unaligned_le16(p) : get_unaligned((const u16 *)p);
+        break;
+    default:
+        raw = type->endianness == IIO_BE ? get_unaligned_be32(p) :
+              type->endianness == IIO_LE ? get_unaligned_le32(p) : get_unaligned((const u32 *)p);
+        break;
+    }
+    raw = (raw >> type->shift) & GENMASK(type->realbits - 1, 0);
+
+    if (type->sign == 's')
+        return (u16)clamp_t(s32, sign_extend32(raw, type->realbits - 1), S16_MIN, S16_MAX);
+    return min_t(u32, raw, U16_MAX);
+}
+
+// Callback des IIO Puffers, wird pro Scan aufgerufen und darf nicht schlafen
+static int monitoring_sys_iio_cb(const void *data, void *private)
+{
+    unsigned long flags;
+    bool first, full;
+    uint16_t value;
+
+    spin_lock_irqsave(&iio_lock, flags);
+    if (!iio_frame || iio_frame->len + 3 * iio_nch > MAX_BUFFER_SIZE - 4)
+    {
+        iio_dropped++;
+        spin_unlock_irqrestore(&iio_lock, flags);
+        return 0;
+    }
+
+    first = iio_frame->len == 1;
+    for (unsigned int i = 0; i < iio_nch; i++) {
+        value = monitoring_sys_iio_value(&iio_map[i], data);
+        iio_frame->data[iio_frame->len++] = iio_map[i].id;
+        iio_frame->data[iio_frame->len++] = value & 0xFF;
+        iio_frame->data[iio_frame->len++] = value >> 8;
+    }
+    iio_samples++;
+    full = iio_frame->len + 3 * iio_nch > MAX_BUFFER_SIZE - 4;
+    spin_unlock_irqrestore(&iio_lock, flags);
+
+    if (full)
+        mod_delayed_work(system_power_efficient_wq, &iio_work, 0);
+    else if (first)
+        queue_delayed_work(system_power_efficient_wq, &iio_work, msecs_to_jiffies(iio_batch_ms));
+    return 0;
+}
+
+// Holt einen leeren Frame aus dem Pool, mit der Adresse als erstem Byte
+static struct monitoring_sys_buf *monitoring_sys_iio_alloc(void)
+{
+    struct monitoring_sys_buf *buf = mempool_alloc(frame_pool, GFP_NOWAIT);
+
+    if (buf)
+    {
+        buf->data[0] = MONITORING_SYS_ADDR;
+        buf->len = 1;
+        buf->origin = MONSYS_FROM_KERNEL;
+    }
+    return buf;
+}
+
+// Tauscht den gefüllten Frame gegen einen leeren und stellt ihn in die Sendewarteschlange
+static void monitoring_sys_iio_work_fn(struct work_struct *work)
+{
+    struct monitoring_sys_buf *next = monitoring_sys_iio_alloc();
+    struct monitoring_sys_buf *done;
+    unsigned long flags;
+
+    spin_lock_irqsave(&iio_lock, flags);
+    done = iio_frame;
+    iio_frame = next;
+    spin_unlock_irqrestore(&iio_lock, flags);
+
+    // Ohne Puffer werden Samples verworfen, bis ein neuer Versuch Erfolg hat
+    if (!next)
+        queue_delayed_work(system_power_efficient_wq, &iio_work, msecs_to_jiffies(iio_batch_ms));
+
+    if (!done)
+        return;
+    if (done->len > 1 && !monitoring_sys_enqueue(done))
+        return;
+    if (done->len > 1)
+    {
+        spin_lock_irqsave(&iio_lock, flags);
+        iio_dropped += (done->len - 1) / (3 * iio_nch);
+        spin_unlock_irqrestore(&iio_lock, flags);
+    }
+    mempool_free(done, frame_pool);
+}
+
+static int monitoring_sys_iio_cmp(const void *a, const void *b)
+{
+    const struct monitoring_sys_iio_map *x = a, *y = b;
+
+    return x->spec->scan_index - y->spec->scan_index;
+}
+
+/*
+    Bindet die io-channels als Callback-Puffer an. Der Puffer enthält nur unsere Kanäle, nach scan_index sortiert
+    und jeweils auf ihre Speichergröße ausgerichtet, daraus ergeben sich die Positionen im Scan.
+*/
+static int monitoring_sys_iio_init(struct device *dev)
+{
+    uint8_t ids[IIO_MAX_CHANNELS];
+    struct iio_channel *chans;
+    unsigned int offset = 0, size;
+    int ret;
+
+    if (!device_property_present(dev, "io-channels"))
+        return 0;
+
+    iio_cb = iio_channel_get_all_cb(dev, monitoring_sys_iio_cb, NULL);
+    if (IS_ERR(iio_cb))
+    {
+        pr_err("monitoring-sys: Couldn't get IIO channels\n");
+        ret = PTR_ERR(iio_cb);
+        iio_cb = NULL;
+        return ret;
+    }
+
+    chans = iio_channel_cb_get_channels(iio_cb);
+    for (iio_nch = 0; chans[iio_nch].indio_dev; iio_nch++)
+        ;
+    if (iio_nch > IIO_MAX_CHANNELS)
+    {
+        pr_err("monitoring-sys: Up to %d io-channels are supported\n", IIO_MAX_CHANNELS);
+        ret = -EINVAL;
+        goto err_release;
+    }
+    ret = device_property_read_u8_array(dev, "iio-ids", ids, iio_nch);
+    if (ret)
+    {
+        pr_err("monitoring-sys: iio-ids needs one value ID per io-channel\n");
+        goto err_release;
+    }
+
+    for (unsigned int i = 0; i < iio_nch; i++) {
+        iio_map[i].spec = chans[i].channel;
+        iio_map[i].id = ids[i];
+    }
+    sort(iio_map, iio_nch, sizeof(iio_map[0]), monitoring_sys_iio_cmp, NULL);
+    for (unsigned int i = 0; i < iio_nch; i++) {
+        size = iio_map[i].spec->scan_type.storagebits / 8;
+        offset = roundup(offset, size);
+        iio_map[i].offset = offset;
+        offset += size * max_t(unsigned int, iio_map[i].spec->scan_type.repeat, 1);
+    }
+
+    iio_frame = monitoring_sys_iio_alloc();
+    if (!iio_frame)
+    {
+        ret = -ENOMEM;
+        goto err_release;
+    }
+    return 0;
+
+err_release:
+    iio_channel_release_all_cb(iio_cb);
+    iio_cb = NULL;
+    iio_nch = 0;
+    return ret;
+}
+
+/*
+    Startet den IIO Puffer. Erst als letzter Schritt des Probe aufrufen, wenn die Sendewarteschlange Frames
+    annimmt, da der Callback ab hier Samples liefert und iio_work plant.
+*/
+static int monitoring_sys_iio_start(void)
+{
+    int ret;
+
+    if (!iio_cb)
+        return 0;
+    ret = iio_channel_start_all_cb(iio_cb);
+    if (ret)
+    {
+        pr_err("monitoring-sys: Couldn't start IIO buffer\n");
+        return ret;
+    }
+    iio_running = true;
+
+    pr_info("monitoring-sys: IIO consumer with %u channels\n", iio_nch);
+    return 0;
+}
+
+// Hält den IIO Puffer an, noch gesammelte Samples werden verworfen
+static void monitoring_sys_iio_exit(void)
+{
+    if (!iio_cb)
+        return;
+    if (iio_running)
+        iio_channel_stop_all_cb(iio_cb);
+    iio_running = false;
+    cancel_delayed_work_sync(&iio_work);
+    if (iio_frame)
+        mempool_free(iio_frame, frame_pool);
+    iio_frame = NULL;
+    iio_channel_release_all_cb(iio_cb);
+    iio_cb = NULL;
+    iio_nch = 0;
+}
+
+static ssize_t iio_samples_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%lu\n", iio_samples);
+}
+static DEVICE_ATTR_RO(iio_samples);
+
+static ssize_t iio_dropped_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%lu\n", iio_dropped);
+}
+static DEVICE_ATTR_RO(iio_dropped);
+
+/*
+    Thermische Alarme. Hat der Knoten #cooling-cells, meldet sich der Treiber als Cooling Device an und wird über
+    die cooling-maps einer Thermal Zone an deren Trip Points gebunden. Der Thermal Core ruft set_cur_state nur auf,
+    wenn ein Trip Point überschritten bzw. wieder unterschritten wurde, es wird also nichts periodisch abgefragt.
+    thermal_work liest dann die Temperatur der Zone thermal-zone und stellt sofort einen Frame
+    [MONITORING_SYS_ADDR][thermal-id, Temperatur in °C als 16 Bit Zweierkomplement] an den Anfang der Warteschlange.
+    Eine Thermal Zone kann nicht direkt abonniert werden, die Bindung als Cooling Device ist der Weg, auf dem der
+    Kernel Trip-Ereignisse an Treiber weitergibt.
+*/
+static struct thermal_cooling_device *thermal_cdev;
+static struct thermal_zone_device *thermal_tz;
+static uint8_t thermal_id;
+static unsigned long thermal_max_state;
+static unsigned long thermal_state;
+static unsigned long thermal_frames;
+static unsigned long thermal_dropped;
+static void monitoring_sys_thermal_work_fn(struct work_struct *work);
+static DECLARE_WORK(thermal_work, monitoring_sys_thermal_work_fn);
+
+static int monitoring_sys_get_max_state(struct thermal_cooling_device *cdev, unsigned long *state)
+{
+    *state = thermal_max_state;
+    return 0;
+}
+
+static int monitoring_sys_get_cur_state(struct thermal_cooling_device *cdev, unsigned long *state)
+{
+    *state = READ_ONCE(thermal_state);
+    return 0;
+}
 
-/* Meta Information */
-MODULE_AUTHOR("Leya Wehner & Julian Frank");
-MODULE_DESCRIPTION("Monitoring System I2C Driver");
-MODULE_LICENSE("GPL");
+// Wird vom Thermal Core beim Überschreiten eines Trip Points aufgerufen, der Frame entsteht in thermal_work
+static int monitoring_sys_set_cur_state(struct thermal_cooling_device *cdev, unsigned long state)
+{
+    if (state > thermal_max_state)
+        return -EINVAL;
+    if (state != READ_ONCE(thermal_state))
+    {
+        WRITE_ONCE(thermal_state, state);
+        queue_work(system_highpri_wq, &thermal_work);
+    }
+    return 0;
+}
 
-/* CRC-32/JAMCRC */
-static uint32_t calculate_crc(const uint8_t *data, size_t len)
+static const struct thermal_cooling_device_ops monitoring_sys_cooling_ops = {
+    .get_max_state = monitoring_sys_get_max_state,
+    .get_cur_state = monitoring_sys_get_cur_state,
+    .set_cur_state = monitoring_sys_set_cur_state,
+};
+
+// Liest die Temperatur der Zone und stellt den Alarm-Frame vor alle anderen Frames
+static void monitoring_sys_thermal_work_fn(struct work_struct *work)
 {
-    return crc32(0xFFFFFFFF, data, len);
+    struct monitoring_sys_buf *buf;
+    int temp;
+
+    if (thermal_zone_get_temp(thermal_tz, &temp))
+    {
+        thermal_dropped++;
+        return;
+    }
+    temp = clamp_t(int, DIV_ROUND_CLOSEST(temp, 1000), S16_MIN, S16_MAX);
+
+    buf = mempool_alloc(frame_pool, GFP_NOWAIT);
+    if (!buf)
+    {
+        thermal_dropped++;
+        return;
+    }
+    buf->data[0] = MONITORING_SYS_ADDR;
+    buf->data[1] = thermal_id;
+    buf->data[2] = (u16)temp & 0xFF;
+    buf->data[3] = (u16)temp >> 8;
+    buf->len = 4;
+    buf->origin = MONSYS_FROM_KERNEL;
+    if (__monitoring_sys_enqueue(buf, true))
+    {
+        mempool_free(buf, frame_pool);
+        thermal_dropped++;
+        return;
+    }
+    thermal_frames++;
+    pr_info("monitoring-sys: Thermal trip state %lu, %d C\n", READ_ONCE(thermal_state), temp);
 }
 
-// Probe function - Wird aufgerufen, wenn ein Gerät erkannt wird
-static int monitoring_sys_probe(struct platform_device *pdev);
+static int monitoring_sys_thermal_init(struct device *dev)
+{
+    const char *zone;
+    u32 levels = 1;
+    int ret;
 
-// Remove function - Wird aufgerufen wenn ein Gerät entfernt wird
-static int monitoring_sys_remove(struct platform_device *pdev);
+    if (!device_property_present(dev, "#cooling-cells"))
+        return 0;
 
-// Device Tree Match Tabelle
-static const struct of_device_id monitoring_sys_of_match[] = {
-    {.compatible = "embedded_linux,monitoring_system"},
-    {/* sentinel */}};
-MODULE_DEVICE_TABLE(of, monitoring_sys_of_match);
+    if (device_property_read_string(dev, "thermal-zone", &zone) ||
+        device_property_read_u8(dev, "thermal-id", &thermal_id))
+    {
+        pr_err("monitoring-sys: #cooling-cells needs thermal-zone and thermal-id\n");
+        return -EINVAL;
+    }
+    thermal_tz = thermal_zone_get_zone_by_name(zone);
+    if (IS_ERR(thermal_tz))
+    {
+        // Die Zone kann später als der Treiber registriert werden
+        ret = PTR_ERR(thermal_tz);
+        thermal_tz = NULL;
+        return ret == -ENODEV ? -EPROBE_DEFER : ret;
+    }
+    device_property_read_u32(dev, "thermal-levels", &levels);
+    thermal_max_state = max(levels, 1U);
+    thermal_state = 0;
 
-// GPIO Treiberstruktur
-static struct platform_driver monitoring_sys_driver = {
-    .driver = {
-        .name = "monitoring-system",
-        .of_match_table = monitoring_sys_of_match,
-    },
-    .probe = monitoring_sys_probe,
-    .remove = monitoring_sys_remove,
-};
+    thermal_cdev = thermal_of_cooling_device_register(dev_of_node(dev), "monitoring-system", NULL,
+                                                      &monitoring_sys_cooling_ops);
+    if (IS_ERR(thermal_cdev))
+    {
+        pr_err("monitoring-sys: Couldn't register cooling device\n");
+        ret = PTR_ERR(thermal_cdev);
+        thermal_cdev = NULL;
+        thermal_tz = NULL;
+        return ret;
+    }
 
-// GPIO-Variablen
-struct gpio_desc *msd = NULL;
-struct gpio_desc *msc = NULL;
+    pr_info("monitoring-sys: Thermal alarms for zone %s as ID 0x%02x\n", zone, thermal_id);
+    return 0;
+}
 
-static struct proc_dir_entry *proc_file = NULL;
+static void monitoring_sys_thermal_exit(void)
+{
+    if (!thermal_cdev)
+        return;
+    thermal_cooling_device_unregister(thermal_cdev);
+    cancel_work_sync(&thermal_work);
+    thermal_cdev = NULL;
+    thermal_tz = NULL;
+}
+
+static ssize_t thermal_frames_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%lu\n", thermal_frames);
+}
+static DEVICE_ATTR_RO(thermal_frames);
+
+static ssize_t thermal_dropped_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    return sysfs_emit(buf, "%lu\n", thermal_dropped);
+}
+static DEVICE_ATTR_RO(thermal_dropped);
 
+// Runtime Suspend: Pins in den pinctrl Zustand "sleep", sofern der Device Tree einen definiert
+static int monitoring_sys_runtime_suspend(struct device *dev)
+{
+    return pinctrl_pm_select_sleep_state(dev);
+}
+
+// Runtime Resume: Pins zurück in den pinctrl Zustand "default"
+static int monitoring_sys_runtime_resume(struct device *dev)
+{
+    int ret;
+
+    ret = pinctrl_pm_select_default_state(dev);
+    if (!ret)
+        pm_resumed = true;
+    return ret;
+}
+
+static const struct dev_pm_ops monitoring_sys_pm_ops = {
+    RUNTIME_PM_OPS(monitoring_sys_runtime_suspend, monitoring_sys_runtime_resume, NULL)
+};
+
+// Schaltet Runtime PM ab und lässt das Gerät aktiv zurück, damit remove die Pins im Zustand "default" freigibt
+static void monitoring_sys_pm_disable(struct device *dev)
+{
+    pm_runtime_get_sync(dev);
+    pm_runtime_disable(dev);
+    pm_runtime_dont_use_autosuspend(dev);
+    pm_runtime_put_noidle(dev);
+}
 
 /*
-    Funktion die aufgerufen wird, wenn in die procfs Datei unter /proc/monitoring-system geschrieben wird. 
-    Die in die Datei geschriebenen Daten werden über den Parameter user_buffer in die Funktion übergeben, und
-    anschließend von dieser mit einer 32-bit CRC Prüfsumme versehen und über die GPIO-Pins übertragen.
+    Gemeinsamer Teil von Platform und SPI Probe: optionale Quittierungs-, Ready- und Empfangsleitungen,
+    Sende-Thread und procfs-File. Die Sendeleitungen bzw. der SPI Controller sind zu diesem Zeitpunkt eingerichtet.
 */
-static ssize_t monitoring_sys_write(struct file *File, const char __user *user_buffer, size_t count, loff_t *offs) {
-    pr_info("monitoring-sys: In the monitoring_sys_write function. count: %zu\n", count);
-    uint8_t kernel_buffer[MAX_BUFFER_SIZE];
-    uint32_t crc;
+static int monitoring_sys_setup(struct device *dev)
+{
     int ret;
-    size_t total_len;
 
-    if (count > MAX_BUFFER_SIZE - 4)
+    ms_dev = dev;
+    WRITE_ONCE(rx_gone, false);
+
+    //Optionale Quittierungsleitung, über die der Empfänger ACK/NACK nach dem CRC meldet
+    msa = gpiod_get_optional(dev, "ack", GPIOD_IN);
+    if (IS_ERR(msa))
     {
-        pr_err("monitoring-sys: count [%zu] > MAX_BUFFER_SIZE\n", count);
-        return -EINVAL;
+        pr_err("monitoring-sys: Couldn't get ack GPIO\n");
+        ret = PTR_ERR(msa);
+        msa = NULL;
+        return ret;
+    }
+    if (msa)
+    {
+        if (gpiod_cansleep(msa))
+        {
+            pr_err("monitoring-sys: ack GPIO must not be on a sleeping controller\n");
+            ret = -EINVAL;
+            goto err_put_msa;
+        }
+        ack_irq = gpiod_to_irq(msa);
+        if (ack_irq < 0)
+        {
+            pr_err("monitoring-sys: ack GPIO has no interrupt\n");
+            ret = ack_irq;
+            goto err_put_msa;
+        }
+        ret = request_irq(ack_irq, monitoring_sys_ack_irq, IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING,
+                          "monitoring-sys-ack", NULL);
+        if (ret)
+        {
+            pr_err("monitoring-sys: Couldn't request ack interrupt\n");
+            goto err_put_msa;
+        }
+        if (window_size > MAX_WINDOW_SIZE)
+            window_size = MAX_WINDOW_SIZE;
+        if (window_size < 1)
+            window_size = 1;
+        pr_info("monitoring-sys: Acknowledge line enabled, %u retries, window %u\n", ack_retries, window_size);
     }
 
-    if ((ret = copy_from_user(kernel_buffer, user_buffer, count)))
+    //Optionale ready/busy Leitung, über die der Empfänger den Sendevorgang pausieren kann
+    msr = gpiod_get_optional(dev, "ready", GPIOD_IN);
+    if (IS_ERR(msr))
     {
-        pr_err("monitoring-sys: Couldn't copy %d of %zu bytes from user buffer to kernel buffer\n", ret, count);
-        return -EFAULT;
+        pr_err("monitoring-sys: Couldn't get ready GPIO\n");
+        ret = PTR_ERR(msr);
+        goto err_free_irq;
+    }
+    if (msr)
+    {
+        // Der Pegel wird in der Bedingung von wait_event_timeout() gelesen, dort darf nicht geschlafen werden
+        if (gpiod_cansleep(msr))
+        {
+            pr_err("monitoring-sys: ready GPIO must not be on a sleeping controller\n");
+            ret = -EINVAL;
+            goto err_put_msr;
+        }
+        ready_irq = gpiod_to_irq(msr);
+        if (ready_irq < 0)
+        {
+            pr_err("monitoring-sys: ready GPIO has no interrupt\n");
+            ret = ready_irq;
+            goto err_put_msr;
+        }
+        ret = request_irq(ready_irq, monitoring_sys_ready_irq, IRQF_TRIGGER_RISING | IRQF_TRIGGER_FALLING,
+                          "monitoring-sys-ready", NULL);
+        if (ret)
+        {
+            pr_err("monitoring-sys: Couldn't request ready interrupt\n");
+            goto err_put_msr;
+        }
+        pr_info("monitoring-sys: Ready line enabled\n");
     }
 
-    crc = calculate_crc(kernel_buffer, count);
-    pr_info("monitoring-sys: crc=0x%08X\n", crc);
-    kernel_buffer[count] = crc & 0xFF;
-    kernel_buffer[count + 1] = (crc >> 8) & 0xFF;
-    kernel_buffer[count + 2] = (crc >> 16) & 0xFF;
-    kernel_buffer[count + 3] = (crc >> 24) & 0xFF;
+    if (delay_threshold_us < 0)
+        monitoring_sys_calibrate_delay();
 
-    total_len = count + 4;
+    tx_worker = kthread_create_worker(0, "monitoring-sys-tx");
+    if (IS_ERR(tx_worker))
+    {
+        pr_err("monitoring-sys: Couldn't create transmit thread\n");
+        ret = PTR_ERR(tx_worker);
+        tx_worker = NULL;
+        goto err_free_ready_irq;
+    }
+    cpumask_copy(&tx_cpus, cpu_possible_mask);
+    tx_worker_cpu = -1;
+    monitoring_sys_apply_priority(tx_priority);
 
-    pr_info("monitoring-sys: total_len=%zu\n", total_len);
+    ret = monitoring_sys_rx_init(dev);
+    if (ret)
+        goto err_destroy_worker;
 
-    for (int i = 0; i < total_len; i++) {
-        pr_info("monitoring-sys: kernel_buffer[%d] = 0x%02X\n", i, kernel_buffer[i]);
-        for (int j = 0; j < 8; j++) {
-            pr_info("monitoring-sys: kernel_buffer[%d] bit [%d] = %u\n", i, j, (kernel_buffer[i] >> j) & 1);
-            gpiod_set_value(msd, (kernel_buffer[i] >> j) & 1);
-            usleep_range(100, 100);
-            gpiod_set_value(msc, 1);
-            usleep_range(200, 200);
-            gpiod_set_value(msc, 0);
-            usleep_range(100, 100);
-        }
+    if (queue_depth < 1)
+        queue_depth = 1;
+    frame_cache = kmem_cache_create("monitoring-sys-frame", sizeof(struct monitoring_sys_buf), 0, 0, NULL);
+    if (!frame_cache)
+    {
+        ret = -ENOMEM;
+        goto err_rx_exit;
+    }
+    frame_pool = mempool_create_slab_pool(queue_depth, frame_cache);
+    if (!frame_pool)
+    {
+        ret = -ENOMEM;
+        goto err_destroy_cache;
     }
-    gpiod_set_value(msd, 0);
-	return total_len;
-};
 
-static struct proc_ops fops = {
-    .proc_write = monitoring_sys_write,
-};
+    // Das Gerät ist nach dem Probe aktiv und suspendiert sich nach autosuspend_ms ohne Übertragung
+    pm_runtime_set_autosuspend_delay(dev, autosuspend_ms);
+    pm_runtime_use_autosuspend(dev);
+    pm_runtime_get_noresume(dev);
+    pm_runtime_set_active(dev);
+    pm_runtime_enable(dev);
+    pm_runtime_mark_last_busy(dev);
+    pm_runtime_put_autosuspend(dev);
 
-// Probe function - Wird aufgerufen, wenn ein Gerät erkannt wird
-static int monitoring_sys_probe(struct platform_device *pdev)
+    ret = monitoring_sys_iio_init(dev);
+    if (ret)
+        goto err_disable_pm;
+
+    ret = monitoring_sys_thermal_init(dev);
+    if (ret)
+        goto err_iio_exit;
+
+    //Erzeugung des procfs-files, maßgeblich für die Kommunikation zwischen Userspace und Kernel
+    proc_file = proc_create("monitoring-system", 0666, NULL, &fops);
+    if (proc_file == NULL)
+    {
+        pr_info("monitoring-sys: Error creating /proc/monitoring-system\n");
+        ret = -ENOMEM;
+        goto err_thermal_exit;
+    }
+
+    spin_lock_bh(&queue_lock);
+    queue_open = true;
+    spin_unlock_bh(&queue_lock);
+
+    ret = monitoring_sys_iio_start();
+    if (ret)
+        goto err_remove_proc;
+    return 0;
+
+err_remove_proc:
+    WRITE_ONCE(rx_gone, true);
+    wake_up_interruptible(&rx_wq);
+    proc_remove(proc_file);
+    proc_file = NULL;
+    monitoring_sys_queue_exit();
+err_thermal_exit:
+    monitoring_sys_thermal_exit();
+err_iio_exit:
+    monitoring_sys_iio_exit();
+err_disable_pm:
+    monitoring_sys_pm_disable(dev);
+    mempool_destroy(frame_pool);
+    frame_pool = NULL;
+err_destroy_cache:
+    kmem_cache_destroy(frame_cache);
+    frame_cache = NULL;
+err_rx_exit:
+    monitoring_sys_rx_exit();
+err_destroy_worker:
+    kthread_destroy_worker(tx_worker);
+    tx_worker = NULL;
+err_free_ready_irq:
+    if (msr)
+        free_irq(ready_irq, NULL);
+err_put_msr:
+    gpiod_put(msr);
+    msr = NULL;
+    ready_irq = -1;
+err_free_irq:
+    if (msa)
+        free_irq(ack_irq, NULL);
+err_put_msa:
+    gpiod_put(msa);
+    msa = NULL;
+    ack_irq = -1;
+    return ret;
+}
+
+// Gemeinsamer Teil von Platform und SPI Remove, gibt alles frei, was monitoring_sys_setup() angelegt hat
+static void monitoring_sys_teardown(void)
 {
-    struct device *dev = &pdev->dev;
+    // proc_remove() wartet auf alle laufenden Aufrufe, blockierende read() Aufrufe müssen vorher aufwachen
+    WRITE_ONCE(rx_gone, true);
+    wake_up_interruptible(&rx_wq);
+    proc_remove(proc_file);
+    proc_file = NULL;
+    monitoring_sys_sampler_bind(false);
+    monitoring_sys_thermal_exit();
+    monitoring_sys_iio_exit();
+    monitoring_sys_queue_exit();
+    cancel_delayed_work_sync(&window_work);
+    win_count = 0;
+    monitoring_sys_pm_disable(ms_dev);
+    kthread_destroy_worker(tx_worker);
+    tx_worker = NULL;
+    mempool_destroy(frame_pool);
+    frame_pool = NULL;
+    kmem_cache_destroy(frame_cache);
+    frame_cache = NULL;
+    monitoring_sys_rx_exit();
+    if (msr)
+        free_irq(ready_irq, NULL);
+    gpiod_put(msr);
+    msr = NULL;
+    ready_irq = -1;
+    if (msa)
+        free_irq(ack_irq, NULL);
+    gpiod_put(msa);
+    msa = NULL;
+    ack_irq = -1;
+}
 
-    pr_info("monitoring-sys: Device probed\n");
+// prepare des GPIO Backends: Betriebsart aus dem Device Tree lesen und msd/msc anfordern
+static int monitoring_sys_gpio_prepare(struct device *dev)
+{
+    int ret;
+
+    target_mode = device_property_read_bool(dev, "target-mode");
+    ddr_mode = device_property_read_bool(dev, "ddr-mode");
+    manchester_mode = device_property_read_bool(dev, "manchester-mode");
+    if (manchester_mode && (target_mode || ddr_mode))
+    {
+        pr_err("monitoring-sys: manchester-mode can't be combined with target-mode or ddr-mode\n");
+        ret = -EINVAL;
+        goto err_modes;
+    }
 
     if (!device_property_present(dev, "msd-gpio"))
     {
         pr_err("monitoring-sys: No msd-gpio property found\n");
-        return -EINVAL;
+        ret = -EINVAL;
+        goto err_modes;
     }
-    if (!device_property_present(dev, "msc-gpio"))
+    if (!manchester_mode && !device_property_present(dev, "msc-gpio"))
     {
         pr_err("monitoring-sys: No msc-gpio property found\n");
-        return -EINVAL;
+        ret = -EINVAL;
+        goto err_modes;
     }
 
     //Initialisierung der GPIOs
-    msd = gpiod_get(dev, "msd", GPIOD_OUT_LOW);
-    if (IS_ERR(msd))
+    msd_lanes = gpiod_get_array(dev, "msd", GPIOD_OUT_LOW);
+    if (IS_ERR(msd_lanes))
     {
         pr_err("monitoring-sys: Couldn't get msd GPIO\n");
-        return PTR_ERR(msd);
+        ret = PTR_ERR(msd_lanes);
+        msd_lanes = NULL;
+        goto err_modes;
+    }
+    msd = msd_lanes->desc[0];
+    if (msd_lanes->ndescs > 1)
+    {
+        if (msd_lanes->ndescs > MONSYS_MAX_LANES || target_mode || manchester_mode)
+        {
+            pr_err("monitoring-sys: Up to %d msd lanes, not in target or manchester mode\n", MONSYS_MAX_LANES);
+            ret = -EINVAL;
+            goto err_put_msd;
+        }
+        pr_info("monitoring-sys: %u data lanes sharing msc\n", msd_lanes->ndescs);
     }
 
-    msc = gpiod_get(dev, "msc", GPIOD_OUT_LOW);
+    if (ddr_mode)
+        pr_info("monitoring-sys: DDR mode enabled, data on both msc edges\n");
+    if (manchester_mode)
+        pr_info("monitoring-sys: Manchester mode enabled, msc is not used\n");
+
+    // Im Manchester Modus bleibt msc frei, ein vorhandenes msc-gpio wird ignoriert
+    msc = manchester_mode ? NULL : gpiod_get(dev, "msc", target_mode ? GPIOD_IN : GPIOD_OUT_LOW);
     if (IS_ERR(msc))
     {
         pr_err("monitoring-sys: Couldn't get msd GPIO\n");
-        return PTR_ERR(msc);
+        ret = PTR_ERR(msc);
+        goto err_put_msd;
     }
 
-    //Erzeugung des procfs-files, maßgeblich für die Kommunikation zwischen Userspace und Kernel
-    proc_file = proc_create("monitoring-system", 0666, NULL, &fops);
-    if (proc_file == NULL)
+    if (target_mode)
     {
-        pr_info("monitoring-sys: Error creating /proc/monitoring-system\n");
-        gpiod_put(msd);
-        gpiod_put(msc);
+        ret = monitoring_sys_target_init();
+        if (ret)
+            goto err_put_msc;
+    }
+
+    tx_cansleep = gpiod_cansleep(msd) || (msc && gpiod_cansleep(msc));
+    if (tx_cansleep)
+        pr_info("monitoring-sys: msd/msc on a sleeping GPIO controller, using the batched cansleep path\n");
+    monitoring_sys_calibrate_toggle();
+
+    return 0;
+
+err_put_msc:
+    gpiod_put(msc);
+    msc = NULL;
+err_put_msd:
+    gpiod_put_array(msd_lanes);
+    msd_lanes = NULL;
+    msd = NULL;
+err_modes:
+    target_mode = false;
+    ddr_mode = false;
+    manchester_mode = false;
+    return ret;
+}
+
+// release des GPIO Backends
+static void monitoring_sys_gpio_release(void)
+{
+    monitoring_sys_target_exit();
+    gpiod_put_array(msd_lanes);
+    gpiod_put(msc);
+    msd_lanes = NULL;
+    msd = NULL;
+    msc = NULL;
+    target_mode = false;
+    ddr_mode = false;
+    manchester_mode = false;
+    tx_cansleep = false;
+}
+
+/*
+    prepare des SPI Backends. Der Controller wird auf Mode 0 (Takt idle low, Abtastung mit steigender Flanke) und
+    LSB first eingestellt, der Takt kommt aus spi-max-frequency. Kann der Controller kein LSB first, werden die Bits
+    in Software gespiegelt.
+*/
+static int monitoring_sys_spi_prepare(struct device *dev)
+{
+    struct spi_device *spi;
+    int ret;
+
+    if (dev->bus != &spi_bus_type)
+    {
+        pr_err("monitoring-sys: spi transport needs a node below an SPI controller\n");
+        return -EINVAL;
+    }
+    spi = to_spi_device(dev);
+
+    // Nur Taktmodus und Bitreihenfolge setzen, Bits aus dem Device Tree (spi-cs-high, spi-3wire, ...) bleiben
+    spi->mode = (spi->mode & ~(SPI_MODE_X_MASK | SPI_LSB_FIRST)) | SPI_MODE_0 | SPI_LSB_FIRST;
+    spi->bits_per_word = 8;
+    spi_swap_bits = false;
+    ret = spi_setup(spi);
+    if (ret)
+    {
+        spi->mode &= ~SPI_LSB_FIRST;
+        spi_swap_bits = true;
+        ret = spi_setup(spi);
+        if (ret)
+        {
+            pr_err("monitoring-sys: Couldn't set up SPI mode 0\n");
+            return ret;
+        }
+    }
+
+    spi_buf = kmalloc(MAX_BUFFER_SIZE + 1, GFP_KERNEL);
+    if (!spi_buf)
         return -ENOMEM;
+
+    ms_spi = spi;
+    pr_info("monitoring-sys: SPI backend at %u Hz%s\n", spi->max_speed_hz,
+            spi_swap_bits ? ", bit order reversed in software" : "");
+    return 0;
+}
+
+// release des SPI Backends
+static void monitoring_sys_spi_release(void)
+{
+    ms_spi = NULL;
+    kfree(spi_buf);
+    spi_buf = NULL;
+}
+
+// prepare des Simulations-Backends, es werden keine Ressourcen benötigt
+static int monitoring_sys_sim_prepare(struct device *dev)
+{
+    pr_info("monitoring-sys: Simulated transport, no lines are driven\n");
+    return 0;
+}
+
+static void monitoring_sys_sim_release(void)
+{
+}
+
+static struct monitoring_sys_transport monitoring_sys_transports[] = {
+    {
+        .name = "gpio",
+        .prepare = monitoring_sys_gpio_prepare,
+        .release = monitoring_sys_gpio_release,
+        .transmit_frame = monitoring_sys_gpio_transmit,
+        .abort = monitoring_sys_gpio_abort,
+        .can_spin = monitoring_sys_gpio_can_spin,
+    },
+    {
+        .name = "spi",
+        .prepare = monitoring_sys_spi_prepare,
+        .release = monitoring_sys_spi_release,
+        .transmit_frame = monitoring_sys_spi_transmit,
+    },
+    {
+        .name = "sim",
+        .prepare = monitoring_sys_sim_prepare,
+        .release = monitoring_sys_sim_release,
+        .transmit_frame = monitoring_sys_sim_transmit,
+    },
+};
+
+/*
+    Gemeinsamer Probe für Platform und SPI Geräte. Das Backend kommt aus der Property transport, ohne sie gilt
+    default_transport ("gpio" unter dem Root-Knoten, "spi" unter einem SPI Controller).
+*/
+static int monitoring_sys_attach(struct device *dev, const char *default_transport)
+{
+    struct monitoring_sys_transport *transport = NULL;
+    const char *name = default_transport;
+    int ret;
+
+    if (proc_file)
+    {
+        pr_err("monitoring-sys: Only one monitoring system is supported\n");
+        return -EBUSY;
+    }
+
+    device_property_read_string(dev, "transport", &name);
+    for (int i = 0; i < ARRAY_SIZE(monitoring_sys_transports); i++)
+        if (!strcmp(name, monitoring_sys_transports[i].name))
+            transport = &monitoring_sys_transports[i];
+    if (!transport)
+    {
+        pr_err("monitoring-sys: Unknown transport %s\n", name);
+        return -EINVAL;
+    }
+
+    ret = transport->prepare(dev);
+    if (ret)
+        return ret;
+
+    memset(&transport->stats, 0, sizeof(transport->stats));
+    ms_transport = transport;
+    ret = monitoring_sys_setup(dev);
+    if (ret)
+    {
+        transport->release();
+        ms_transport = NULL;
+        return ret;
     }
 
+    monitoring_sys_sampler_bind(true);
+    pr_info("monitoring-sys: Using %s transport\n", transport->name);
     return 0;
+}
+
+// Gemeinsamer Remove für Platform und SPI Geräte
+static void monitoring_sys_detach(void)
+{
+    monitoring_sys_teardown();
+    ms_transport->release();
+    ms_transport = NULL;
+}
+
+// Probe function - Wird aufgerufen, wenn ein Gerät erkannt wird
+static int monitoring_sys_probe(struct platform_device *pdev)
+{
+    pr_info("monitoring-sys: Device probed\n");
+    return monitoring_sys_attach(&pdev->dev, "gpio");
 };
 
 /*
@@ -171,15 +3582,74 @@ static int monitoring_sys_probe(struct platform_device *pdev)
 static int monitoring_sys_remove(struct platform_device *pdev)
 {
     pr_info("monitoring-sys: Device removed\n");
-    gpiod_put(msd);
-    gpiod_put(msc);
-    proc_remove(proc_file);
-    proc_file = NULL;
-    msd = NULL;
-    msc = NULL;
+    monitoring_sys_detach();
     return 0;
 };
 
+// SPI Probe - Wird aufgerufen, wenn der Device Tree Knoten unter einem SPI Controller liegt
+static int monitoring_sys_spi_probe(struct spi_device *spi)
+{
+    pr_info("monitoring-sys: SPI device probed\n");
+    return monitoring_sys_attach(&spi->dev, "spi");
+}
+
+// SPI Remove - Gibt das Backend wieder frei
+static void monitoring_sys_spi_remove(struct spi_device *spi)
+{
+    pr_info("monitoring-sys: SPI device removed\n");
+    monitoring_sys_detach();
+}
+
+// sysfs Attribute des Geräts
+static struct attribute *monitoring_sys_attrs[] = {
+    &dev_attr_transport.attr,
+    &dev_attr_transport_stats.attr,
+    &dev_attr_bit_rate.attr,
+    &dev_attr_rate_level.attr,
+    &dev_attr_delay_threshold_us.attr,
+    &dev_attr_toggle_cost_ns.attr,
+    &dev_attr_tx_priority.attr,
+    &dev_attr_tx_cpus.attr,
+    &dev_attr_rx_frames.attr,
+    &dev_attr_rx_crc_errors.attr,
+    &dev_attr_rx_dropped.attr,
+    &dev_attr_txn_latency.attr,
+    &dev_attr_txn_timeouts.attr,
+    &dev_attr_producer_errors.attr,
+    &dev_attr_pm_resume_latency.attr,
+    &dev_attr_iio_samples.attr,
+    &dev_attr_iio_dropped.attr,
+    &dev_attr_thermal_frames.attr,
+    &dev_attr_thermal_dropped.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(monitoring_sys);
+
+// GPIO Treiberstruktur
+static struct platform_driver monitoring_sys_driver = {
+    .driver = {
+        .name = "monitoring-system",
+        .of_match_table = monitoring_sys_of_match,
+        .dev_groups = monitoring_sys_groups,
+        .pm = pm_ptr(&monitoring_sys_pm_ops),
+    },
+    .probe = monitoring_sys_probe,
+    .remove = monitoring_sys_remove,
+};
+
+// SPI Treiberstruktur, für Knoten unter einem SPI Controller
+static struct spi_driver monitoring_sys_spi_driver = {
+    .driver = {
+        .name = "monitoring-system",
+        .of_match_table = monitoring_sys_of_match,
+        .dev_groups = monitoring_sys_groups,
+        .pm = pm_ptr(&monitoring_sys_pm_ops),
+    },
+    .id_table = monitoring_sys_spi_ids,
+    .probe = monitoring_sys_spi_probe,
+    .remove = monitoring_sys_spi_remove,
+};
+
 /*
     Diese Funktion wird aufgerufen, wenn das Modul in den Kernel geladen wird,
     und registriert den Treiber.
@@ -190,6 +3660,19 @@ static int __init monitoring_system_init(void) {
 		printk("monitoring-sys: Error! Could not load driver\n");
 		return -1;
 	}
+	if(spi_register_driver(&monitoring_sys_spi_driver)) {
+		printk("monitoring-sys: Error! Could not load SPI driver\n");
+		platform_driver_unregister(&monitoring_sys_driver);
+		return -1;
+	}
+	config_group_init(&monitoring_sys_subsys.su_group);
+	mutex_init(&monitoring_sys_subsys.su_mutex);
+	if(configfs_register_subsystem(&monitoring_sys_subsys)) {
+		printk("monitoring-sys: Error! Could not register configfs subsystem\n");
+		spi_unregister_driver(&monitoring_sys_spi_driver);
+		platform_driver_unregister(&monitoring_sys_driver);
+		return -1;
+	}
 	return 0;
 }
 
@@ -199,6 +3682,8 @@ static int __init monitoring_system_init(void) {
 */
 static void __exit monitoring_system_exit(void) {
 	printk("monitoring sys: Unloading the driver...\n");
+	configfs_unregister_subsystem(&monitoring_sys_subsys);
+	spi_unregister_driver(&monitoring_sys_spi_driver);
 	platform_driver_unregister(&monitoring_sys_driver);
 }
 
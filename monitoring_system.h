@@ -0,0 +1,74 @@
+/*
+monitoring_system.h
+Gemeinsame Definitionen für den Monitoring System Treiber und Userspace Programme (z.B. sysmond),
+die die ioctl Schnittstelle von /proc/monitoring-system nutzen.
+*/
+
+#ifndef MONITORING_SYSTEM_H
+#define MONITORING_SYSTEM_H
+
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
+/*
+    Anfrage/Antwort Transaktion: Der Treiber sendet den Frame [addr][req] mit CRC, wartet im Kernel auf einen
+    Antwort-Frame, dessen erstes Byte addr ist, und gibt ihn (ohne CRC) in resp zurück.
+*/
+struct monsys_transaction {
+    __u8 addr;          // Adresse des Empfängers, erstes Byte des gesendeten und des erwarteten Frames
+    __u8 reserved[3];
+    __u32 timeout_ms;   // Maximale Wartezeit auf die Antwort
+    __u64 req;          // Zeiger auf die Nutzdaten der Anfrage (ohne Adresse)
+    __u32 req_len;
+    __u32 resp_len;     // Eingabe: Größe des Antwortpuffers, Ausgabe: Länge der Antwort inklusive Adresse
+    __u64 resp;         // Zeiger auf den Antwortpuffer
+    __u32 latency_us;   // Ausgabe: Zeit vom Beginn der Anfrage bis zum Ende der Antwort
+    __u32 reserved2;
+};
+
+#define MONSYS_MAX_LANES 8
+
+/*
+    Parallele Übertragung an mehrere Empfänger mit gemeinsamem msc (msd-gpio mit mehreren Einträgen).
+    frames[i]/len[i] ist der Frame (ohne CRC) für die Datenleitung i, len[i] == 0 lässt die Leitung ruhen.
+    Frames gleicher Länge werden gleichzeitig getaktet, unterschiedliche Längen nacheinander.
+*/
+struct monsys_parallel {
+    __u64 frames[MONSYS_MAX_LANES];
+    __u32 len[MONSYS_MAX_LANES];
+};
+
+#define MONSYS_IOC_MAGIC 'm'
+#define MONSYS_IOC_TRANSACT _IOWR(MONSYS_IOC_MAGIC, 1, struct monsys_transaction)
+#define MONSYS_IOC_SEND_PARALLEL _IOW(MONSYS_IOC_MAGIC, 2, struct monsys_parallel)
+// Wartet, bis alle mit write() eingereihten Frames übertragen sind, und liefert einen dabei aufgetretenen Fehler
+#define MONSYS_IOC_FLUSH _IO(MONSYS_IOC_MAGIC, 3)
+
+#ifdef __KERNEL__
+
+#define MONSYS_MAX_PAIRS 256 // Wert IDs pro Frame, 1 Byte Adresse + 256 * 3 Byte + 4 Byte CRC = MAX_BUFFER_SIZE
+
+// Ein Wert für monsys_submit(), wird als [id, value 16 Bit little endian] in den Frame übernommen
+struct monsys_pair {
+    u8 id;
+    u16 value;
+};
+
+#define MONSYS_SUBMIT_URGENT (1U << 0) // Frame vor allen wartenden Frames senden
+
+/*
+    Stellt einen Frame aus n (1..MONSYS_MAX_PAIRS) Paaren in die Sendewarteschlange des Monitoring Systems.
+    Aus Prozess- und Softirq-Kontext aufrufbar, wartet nie. 0 bei Erfolg, sonst -EINVAL, -ENODEV, -ENOMEM
+    oder -EAGAIN (Warteschlange voll).
+*/
+int monsys_submit(const struct monsys_pair *pairs, unsigned int n, unsigned int flags);
+
+/*
+    Setzt den Wert einer ID in der Wertetabelle des In-Kernel Samplers. Gesendet wird er im Takt des per configfs
+    angelegten Kanals mit dieser ID (ohne source). Aus jedem Kontext aufrufbar.
+*/
+void monsys_set_value(u8 id, u16 value);
+
+#endif /* __KERNEL__ */
+
+#endif